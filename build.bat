@@ -50,7 +50,7 @@ goto arg_loop
 if not exist %OBJDIR% mkdir %OBJDIR%
 
 :: Source files
-set SOURCES=filecompressor.c huffman.c rle.c lz77.c parallel.c compression.c large_file_utils.c lz77_parallel.c encryption.c progressive.c split_archive.c deduplication.c
+set SOURCES=filecompressor.c huffman.c rle.c lz77.c parallel.c compression.c large_file_utils.c lz77_parallel.c encryption.c progressive.c split_archive.c deduplication.c crc32.c xxh64.c
 
 :: Handle release build
 if %RELEASE%==1 (
@@ -26,6 +26,7 @@ static int thread_count = DEFAULT_THREADS;
 // Wrapper functions for parallel compression
 int compress_huffman_parallel(const char *input_file, const char *output_file) {
     CompressionAlgorithm *huffman = get_algorithm_by_type(HUFFMAN);
+    set_huffman_optimization(get_optimization_goal());
     return compress_file_parallel(input_file, output_file, huffman, thread_count);
 }
 
@@ -77,6 +78,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".huf";
     algorithms[algorithm_count].compress = compress_file;
     algorithms[algorithm_count].decompress = decompress_file;
+    algorithms[algorithm_count].buffer_compress = compress_huffman_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_huffman_buffer;
+    algorithms[algorithm_count].buffer_bound = huffman_compress_bound;
     algorithm_count++;
     
     // Add RLE algorithm
@@ -85,6 +89,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".rle";
     algorithms[algorithm_count].compress = compress_rle;
     algorithms[algorithm_count].decompress = decompress_rle;
+    algorithms[algorithm_count].buffer_compress = compress_rle_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_rle_buffer;
+    algorithms[algorithm_count].buffer_bound = rle_compress_bound;
     algorithm_count++;
     
     // Add parallel Huffman coding algorithm
@@ -93,6 +100,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".hufp";
     algorithms[algorithm_count].compress = compress_huffman_parallel;
     algorithms[algorithm_count].decompress = decompress_huffman_parallel;
+    algorithms[algorithm_count].buffer_compress = compress_huffman_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_huffman_buffer;
+    algorithms[algorithm_count].buffer_bound = huffman_compress_bound;
     algorithm_count++;
     
     // Add parallel RLE algorithm
@@ -101,6 +111,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".rlep";
     algorithms[algorithm_count].compress = compress_rle_parallel;
     algorithms[algorithm_count].decompress = decompress_rle_parallel;
+    algorithms[algorithm_count].buffer_compress = compress_rle_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_rle_buffer;
+    algorithms[algorithm_count].buffer_bound = rle_compress_bound;
     algorithm_count++;
     
     // Add LZ77 algorithm
@@ -109,6 +122,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".lz77";
     algorithms[algorithm_count].compress = compress_lz77;
     algorithms[algorithm_count].decompress = decompress_lz77;
+    algorithms[algorithm_count].buffer_compress = compress_lz77_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_lz77_buffer;
+    algorithms[algorithm_count].buffer_bound = lz77_compress_bound;
     algorithm_count++;
     
     // Add parallel LZ77 algorithm
@@ -117,6 +133,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".lz77p";
     algorithms[algorithm_count].compress = compress_lz77_parallel;
     algorithms[algorithm_count].decompress = decompress_lz77_parallel;
+    algorithms[algorithm_count].buffer_compress = compress_lz77_buffer;
+    algorithms[algorithm_count].buffer_decompress = decompress_lz77_buffer;
+    algorithms[algorithm_count].buffer_bound = lz77_compress_bound;
     algorithm_count++;
     
     // Add encrypted LZ77 algorithm
@@ -125,6 +144,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".lz77e";
     algorithms[algorithm_count].compress = compress_encrypted_lz77;
     algorithms[algorithm_count].decompress = decompress_encrypted_lz77;
+    algorithms[algorithm_count].buffer_compress = NULL;
+    algorithms[algorithm_count].buffer_decompress = NULL;
+    algorithms[algorithm_count].buffer_bound = NULL;
     algorithm_count++;
     
     // Add Progressive format algorithm
@@ -133,6 +155,9 @@ void init_compression_algorithms() {
     algorithms[algorithm_count].extension = ".prog";
     algorithms[algorithm_count].compress = compress_progressive;
     algorithms[algorithm_count].decompress = decompress_progressive;
+    algorithms[algorithm_count].buffer_compress = NULL;
+    algorithms[algorithm_count].buffer_decompress = NULL;
+    algorithms[algorithm_count].buffer_bound = NULL;
     algorithm_count++;
     
     // Initialize the parallel subsystem
@@ -183,6 +208,9 @@ void set_thread_count(int count) {
     } else {
         thread_count = MAX_THREADS;
     }
+    
+    // Size the shared worker pool to match
+    init_parallel_compression(thread_count);
 }
 
 // Profiling functions implementation
@@ -252,70 +280,54 @@ int detect_algorithm_from_file(const char* filename) {
     return -1; // Unknown format
 }
 
+// Look up an algorithm that has an in-memory codec
+static CompressionAlgorithm* get_buffer_algorithm(int algorithm_index) {
+    CompressionAlgorithm* algorithm = get_algorithm(algorithm_index);
+    if (!algorithm || !algorithm->buffer_compress || !algorithm->buffer_decompress) {
+        return NULL;
+    }
+    return algorithm;
+}
+
+// Worst-case buffer-based compression output size
+size_t compress_bound(int algorithm_index, size_t input_size) {
+    CompressionAlgorithm* algorithm = get_buffer_algorithm(algorithm_index);
+    if (!algorithm || !algorithm->buffer_bound) {
+        return 0;
+    }
+    return algorithm->buffer_bound(input_size);
+}
+
 // Buffer-based compression
 int compress_buffer(int algorithm_index, const uint8_t* input, size_t input_size, 
                    uint8_t* output, size_t* output_size) {
-    // This is a simplified implementation - in a real implementation,
-    // we would have buffer-based versions of each compression algorithm
-    if (algorithm_index == HUFFMAN) {
-        // Call Huffman buffer-based compression
-        // For now, we'll just copy data as a placeholder
-        if (*output_size < input_size) {
-            fprintf(stderr, "Output buffer too small\n");
-            return 0;
-        }
-        memcpy(output, input, input_size);
-        *output_size = input_size;
-        return 1;
-    }
-    else if (algorithm_index == RLE) {
-        // Call RLE buffer-based compression
-        // For now, we'll just copy data as a placeholder
-        if (*output_size < input_size) {
-            fprintf(stderr, "Output buffer too small\n");
-            return 0;
-        }
-        memcpy(output, input, input_size);
-        *output_size = input_size;
-        return 1;
+    CompressionAlgorithm* algorithm = get_buffer_algorithm(algorithm_index);
+    if (!algorithm) {
+        fprintf(stderr, "Unsupported algorithm for buffer compression\n");
+        return 0;
     }
-    // Add similar cases for other algorithms
     
-    fprintf(stderr, "Unsupported algorithm for buffer compression\n");
-    return 0;
+    if (algorithm->buffer_compress(input, input_size, output, output_size) != 0) {
+        fprintf(stderr, "%s buffer compression failed\n", algorithm->name);
+        return 0;
+    }
+    return 1;
 }
 
 // Buffer-based decompression
 int decompress_buffer(int algorithm_index, const uint8_t* input, size_t input_size, 
                      uint8_t* output, size_t* output_size) {
-    // This is a simplified implementation - in a real implementation,
-    // we would have buffer-based versions of each decompression algorithm
-    if (algorithm_index == HUFFMAN) {
-        // Call Huffman buffer-based decompression
-        // For now, we'll just copy data as a placeholder
-        if (*output_size < input_size) {
-            fprintf(stderr, "Output buffer too small\n");
-            return 0;
-        }
-        memcpy(output, input, input_size);
-        *output_size = input_size;
-        return 1;
-    }
-    else if (algorithm_index == RLE) {
-        // Call RLE buffer-based decompression
-        // For now, we'll just copy data as a placeholder
-        if (*output_size < input_size) {
-            fprintf(stderr, "Output buffer too small\n");
-            return 0;
-        }
-        memcpy(output, input, input_size);
-        *output_size = input_size;
-        return 1;
+    CompressionAlgorithm* algorithm = get_buffer_algorithm(algorithm_index);
+    if (!algorithm) {
+        fprintf(stderr, "Unsupported algorithm for buffer decompression\n");
+        return 0;
     }
-    // Add similar cases for other algorithms
     
-    fprintf(stderr, "Unsupported algorithm for buffer decompression\n");
-    return 0;
+    if (algorithm->buffer_decompress(input, input_size, output, output_size) != 0) {
+        fprintf(stderr, "%s buffer decompression failed\n", algorithm->name);
+        return 0;
+    }
+    return 1;
 }
 
 // High-level file compression function
@@ -33,6 +33,13 @@ typedef enum {
 typedef int (*CompressFunc)(const char*, const char*);
 typedef int (*DecompressFunc)(const char*, const char*);
 
+// Function pointer types for in-memory codecs (return 0 on success)
+// The size argument holds the output capacity on entry and the bytes produced on return
+typedef int (*BufferCompressFunc)(const uint8_t*, size_t, uint8_t*, size_t*);
+typedef int (*BufferDecompressFunc)(const uint8_t*, size_t, uint8_t*, size_t*);
+// Worst-case compressed size for a given input size
+typedef size_t (*BufferBoundFunc)(size_t);
+
 // Compression algorithm structure
 typedef struct {
     const char* name;         // Algorithm name
@@ -40,6 +47,9 @@ typedef struct {
     const char* extension;    // File extension
     CompressFunc compress;    // Compression function
     DecompressFunc decompress; // Decompression function
+    BufferCompressFunc buffer_compress;     // In-memory compression (NULL if unsupported)
+    BufferDecompressFunc buffer_decompress; // In-memory decompression (NULL if unsupported)
+    BufferBoundFunc buffer_bound;           // Worst-case in-memory output size (NULL if unsupported)
 } CompressionAlgorithm;
 
 // Profiling data structure
@@ -75,7 +85,9 @@ void print_profiling_results(ProfileData* profile);
 int compress_large_file(const char* input_file, const char* output_file, size_t chunk_size);
 int decompress_large_file(const char* input_file, const char* output_file, size_t chunk_size);
 
-// Buffer-based compression/decompression interface
+// Buffer-based compression/decompression interface (return 1 on success, 0 on failure)
+// Worst-case output size of compress_buffer for input_size bytes, 0 if the algorithm has no buffer codec
+size_t compress_bound(int algorithm_index, size_t input_size);
 int compress_buffer(int algorithm_index, const uint8_t* input, size_t input_size, 
                    uint8_t* output, size_t* output_size);
 int decompress_buffer(int algorithm_index, const uint8_t* input, size_t input_size, 
@@ -0,0 +1,276 @@
+/**
+ * CRC32 Checksum Implementation
+ *
+ * The portable kernel is slice-by-16: sixteen 256-entry tables let it consume
+ * 16 bytes per step instead of one. On x86 CPUs with PCLMULQDQ, buffers of 64
+ * bytes or more are folded with carry-less multiplies instead (Gopal et al.,
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction",
+ * Intel 2009), and the tail is finished with the table kernel. The kernel is
+ * chosen once through CPUID.
+ *
+ * CRCs of separately checksummed pieces are merged by multiplying the first
+ * by x^(8 * size of the second) modulo the polynomial, as zlib's crc32_combine
+ * does, so chunks can be checksummed on different threads.
+ */
+#include <pthread.h>
+#include "crc32.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32_HAVE_PCLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// Reflected CRC32 polynomial
+#define CRC32_POLYNOMIAL 0xEDB88320u
+
+// Tables for slice-by-16, crc32_tables[0] being the classic byte table
+static uint32_t crc32_tables[16][256];
+
+// Kernel working on the raw (uninverted) CRC state
+typedef uint32_t (*Crc32Kernel)(uint32_t state, const uint8_t* data, size_t size);
+
+// x^(2^n) mod P for n = 0..31, used to shift a CRC past runs of zero bytes
+static uint32_t crc32_x2n_table[32];
+
+static Crc32Kernel crc32_kernel;
+static const char* crc32_kernel_name;
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+// Load 4 bytes as a little-endian word
+static inline uint32_t load_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Table kernel: 16 bytes per step, then byte at a time
+static uint32_t crc32_slice16(uint32_t state, const uint8_t* data, size_t size) {
+    while (size >= 16) {
+        uint32_t a = load_le32(data) ^ state;
+        uint32_t b = load_le32(data + 4);
+        uint32_t c = load_le32(data + 8);
+        uint32_t d = load_le32(data + 12);
+
+        state = crc32_tables[15][a & 0xFF] ^ crc32_tables[14][(a >> 8) & 0xFF] ^
+                crc32_tables[13][(a >> 16) & 0xFF] ^ crc32_tables[12][a >> 24] ^
+                crc32_tables[11][b & 0xFF] ^ crc32_tables[10][(b >> 8) & 0xFF] ^
+                crc32_tables[9][(b >> 16) & 0xFF] ^ crc32_tables[8][b >> 24] ^
+                crc32_tables[7][c & 0xFF] ^ crc32_tables[6][(c >> 8) & 0xFF] ^
+                crc32_tables[5][(c >> 16) & 0xFF] ^ crc32_tables[4][c >> 24] ^
+                crc32_tables[3][d & 0xFF] ^ crc32_tables[2][(d >> 8) & 0xFF] ^
+                crc32_tables[1][(d >> 16) & 0xFF] ^ crc32_tables[0][d >> 24];
+
+        data += 16;
+        size -= 16;
+    }
+
+    while (size--) {
+        state = (state >> 8) ^ crc32_tables[0][(state ^ *data++) & 0xFF];
+    }
+    return state;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+// Folding constants for the reflected polynomial: x^(4*128+32), x^(4*128-32),
+// x^(128+32), x^(128-32) and x^64 mod P, then the Barrett constants mu and P
+static const uint64_t crc32_k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t crc32_k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t crc32_k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t crc32_poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+
+// Carry-less multiply kernel: folds four 128-bit lanes per 64 bytes, then reduces
+// Requires size >= 64 and a multiple of 16
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t state, const uint8_t* data, size_t size) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)state));
+
+    x0 = _mm_load_si128((const __m128i*)crc32_k1k2);
+    data += 64;
+    size -= 64;
+
+    // Fold 64 bytes at a time into the four lanes
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+
+        data += 64;
+        size -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)crc32_k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold any remaining 16-byte blocks
+    while (size >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        data += 16;
+        size -= 16;
+    }
+
+    // Fold 128 bits down to 64
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)crc32_k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)crc32_poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+// PCLMULQDQ kernel: fold whole 16-byte blocks, finish the tail with tables
+static uint32_t crc32_pclmul(uint32_t state, const uint8_t* data, size_t size) {
+    if (size >= 64) {
+        size_t folded = size & ~(size_t)15;
+        state = crc32_pclmul_fold(state, data, folded);
+        data += folded;
+        size -= folded;
+    }
+    return crc32_slice16(state, data, size);
+}
+
+// Whether the CPU supports PCLMULQDQ and SSE4.1
+static int cpu_has_pclmul(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+}
+#endif
+
+// Multiply two polynomials modulo P (reflected bit order, x^0 in the top bit)
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLYNOMIAL : b >> 1;
+    }
+    return p;
+}
+
+// x^(n * 2^k) mod P by square-and-multiply over the bits of n
+static uint32_t crc32_x2nmodp(uint64_t n, unsigned int k) {
+    uint32_t p = 1u << 31;  // x^0
+    while (n) {
+        if (n & 1) {
+            p = crc32_multmodp(crc32_x2n_table[k & 31], p);
+        }
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+// Build the tables and pick the kernel for this CPU
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; j++) {
+            c = (c & 1) ? (CRC32_POLYNOMIAL ^ (c >> 1)) : (c >> 1);
+        }
+        crc32_tables[0][i] = c;
+    }
+    for (int t = 1; t < 16; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc32_tables[t - 1][i];
+            crc32_tables[t][i] = (c >> 8) ^ crc32_tables[0][c & 0xFF];
+        }
+    }
+
+    uint32_t p = 1u << 30;  // x^1
+    crc32_x2n_table[0] = p;
+    for (int n = 1; n < 32; n++) {
+        crc32_x2n_table[n] = p = crc32_multmodp(p, p);
+    }
+
+    crc32_kernel = crc32_slice16;
+    crc32_kernel_name = "slice-by-16";
+#ifdef CRC32_HAVE_PCLMUL
+    if (cpu_has_pclmul()) {
+        crc32_kernel = crc32_pclmul;
+        crc32_kernel_name = "pclmul";
+    }
+#endif
+}
+
+// Continue a CRC32 over more data
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    pthread_once(&crc32_once, crc32_init);
+    if (!data || size == 0) {
+        return crc;
+    }
+    return ~crc32_kernel(~crc, data, size);
+}
+
+// CRC32 of a buffer
+uint32_t crc32_compute(const uint8_t* data, size_t size) {
+    return crc32_update(0, data, size);
+}
+
+// CRC32 of two concatenated buffers from their CRCs, in O(log size2)
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+    pthread_once(&crc32_once, crc32_init);
+    return crc32_multmodp(crc32_x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+// Name of the kernel in use
+const char* crc32_implementation(void) {
+    pthread_once(&crc32_once, crc32_init);
+    return crc32_kernel_name;
+}
@@ -0,0 +1,27 @@
+/**
+ * CRC32 Checksums
+ * IEEE 802.3 CRC32 (reflected polynomial 0xEDB88320) shared by the checksum and
+ * deduplication code, with the fastest kernel for the running CPU picked at startup.
+ * Checksums of chunks computed on different threads can be merged with crc32_combine
+ */
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Continue a CRC32 over more data (start with crc = 0)
+// crc32_update(crc32_update(0, a, n), b, m) equals the CRC32 of a followed by b
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size);
+
+// CRC32 of a buffer
+uint32_t crc32_compute(const uint8_t* data, size_t size);
+
+// CRC32 of a buffer A followed by a buffer B, given crc1 = CRC32(A), crc2 = CRC32(B)
+// and size2 = length of B, without touching the data (O(log size2))
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+// Name of the kernel in use ("pclmul" or "slice-by-16")
+const char* crc32_implementation(void);
+
+#endif /* CRC32_H */
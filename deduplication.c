@@ -10,6 +10,8 @@
 #include "deduplication.h"
 #include "large_file_utils.h"
 #include "compression.h"
+#include "crc32.h"
+#include "xxh64.h"
 #include "filecompressor.h"
 
 // Chunk hash entry
@@ -57,26 +59,6 @@ static void compute_md5_hash(const uint8_t* data, size_t size, unsigned char* ha
     MD5_Final(hash, &ctx);
 }
 
-// Helper function to compute CRC32 hash
-static uint32_t compute_crc32(const uint8_t* data, size_t size) {
-    // Simple CRC32 implementation
-    uint32_t crc = 0xFFFFFFFF;
-    const uint32_t polynomial = 0xEDB88320;
-    
-    for (size_t i = 0; i < size; i++) {
-        crc ^= data[i];
-        for (size_t j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ polynomial;
-            } else {
-                crc = crc >> 1;
-            }
-        }
-    }
-    
-    return ~crc;
-}
-
 // Helper function to compute hash based on selected algorithm
 static void compute_hash(const uint8_t* data, size_t size, unsigned char* hash) {
     switch (current_hash_algorithm) {
@@ -87,15 +69,17 @@ static void compute_hash(const uint8_t* data, size_t size, unsigned char* hash)
             compute_md5_hash(data, size, hash);
             break;
         case DEDUP_HASH_CRC32: {
-            uint32_t crc = compute_crc32(data, size);
+            uint32_t crc = crc32_compute(data, size);
             memcpy(hash, &crc, sizeof(crc));
             memset(hash + sizeof(crc), 0, SHA_DIGEST_LENGTH - sizeof(crc));
             break;
         }
-        case DEDUP_HASH_XXH64:
-            // XXH64 not implemented in this example, use SHA1 instead
-            compute_sha1_hash(data, size, hash);
+        case DEDUP_HASH_XXH64: {
+            uint64_t value = xxh64(data, size, 0);
+            memcpy(hash, &value, sizeof(value));
+            memset(hash + sizeof(value), 0, SHA_DIGEST_LENGTH - sizeof(value));
             break;
+        }
     }
 }
 
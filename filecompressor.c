@@ -39,10 +39,11 @@ void print_usage() {
     printf("  -O [goal]       Optimization goal: speed or size\n");
     printf("  -B [size]       Buffer size in bytes (default: 8192)\n");
     printf("  -L              Enable large file mode for files larger than available RAM\n");
-    printf("  -I [type]       Enable integrity verification with checksum (1=CRC32, 2=MD5, 3=SHA256)\n");
+    printf("  -I [type]       Enable integrity verification with checksum (1=CRC32, 2=MD5, 3=SHA256, 4=XXH64)\n");
     printf("  -p              Enable profiling\n");
     printf("  -P              Use progressive format (supports partial decompression)\n");
     printf("  -R [start-end]  Decompress only a range of blocks (requires -P)\n");
+    printf("  -E [off:len]    Extract len bytes starting at byte offset off (requires -P)\n");
     printf("  -S [output]     Stream output to a callback function (e.g., display or process)\n");
     printf("  -X              Enable split archive mode (create multiple files)\n");
     printf("  -M [size]       Maximum size in bytes for each split archive part (default: 100MB)\n");
@@ -63,6 +64,7 @@ void print_usage() {
     printf("  filecompressor -c 0 -I 1 input.txt              # Compress with CRC32 integrity verification\n");
     printf("  filecompressor -c 0 -P input.txt                # Compress with progressive format\n");
     printf("  filecompressor -d -P -R 5-10 input.prog out.txt # Decompress blocks 5-10 only\n");
+    printf("  filecompressor -d -P -E 4096:512 in.prog out    # Extract 512 bytes at offset 4096\n");
     printf("  filecompressor -c 0 -X input.txt                # Create split archive with default part size\n");
     printf("  filecompressor -c 0 -X -M 10485760 input.txt    # Create split archive with 10MB part size\n");
     printf("  filecompressor -d input.txt output.txt -X       # Decompress split archive\n");
@@ -154,6 +156,8 @@ int main(int argc, char *argv[]) {
     uint64_t max_part_size = DEFAULT_SPLIT_SIZE; // Default max part size for split archives
     uint32_t start_block = 0, end_block = UINT32_MAX; // For partial decompression
     int range_specified = 0;
+    uint64_t extract_offset = 0, extract_length = 0; // For byte range extraction
+    int extract_specified = 0;
     int stream_mode = 0;
     ChecksumType checksum_type = CHECKSUM_NONE; // Default to no checksum
     
@@ -188,16 +192,16 @@ int main(int argc, char *argv[]) {
                 // Checksum type
                 if (i + 1 < argc) {
                     int type = atoi(argv[i + 1]);
-                    if (type >= CHECKSUM_NONE && type <= CHECKSUM_SHA256) {
+                    if (type >= CHECKSUM_NONE && type <= CHECKSUM_XXH64) {
                         checksum_type = (ChecksumType)type;
                         
                         const char* checksum_names[] = {
-                            "None", "CRC32", "MD5", "SHA256"
+                            "None", "CRC32", "MD5", "SHA256", "XXH64"
                         };
                         
                         printf("Integrity verification: %s\n", checksum_names[checksum_type]);
                     } else {
-                        printf("Error: Invalid checksum type. Use 0 (none), 1 (CRC32), 2 (MD5), or 3 (SHA256)\n");
+                        printf("Error: Invalid checksum type. Use 0 (none), 1 (CRC32), 2 (MD5), 3 (SHA256), or 4 (XXH64)\n");
                         print_usage();
                         return 1;
                     }
@@ -301,6 +305,30 @@ int main(int argc, char *argv[]) {
                     print_usage();
                     return 1;
                 }
+            } else if (strcmp(arg, "-E") == 0) {
+                // Byte range to extract
+                if (i + 1 < argc) {
+                    // Parse range in format "offset:length"
+                    char* range = argv[i + 1];
+                    char* colon = strchr(range, ':');
+                    if (colon) {
+                        *colon = '\0'; // Split the string at the colon
+                        extract_offset = strtoull(range, NULL, 10);
+                        extract_length = strtoull(colon + 1, NULL, 10);
+                        extract_specified = 1;
+                        printf("Extracting %llu bytes from offset %llu\n",
+                               (unsigned long long)extract_length, (unsigned long long)extract_offset);
+                    } else {
+                        printf("Error: Invalid byte range format. Use 'offset:length'\n");
+                        print_usage();
+                        return 1;
+                    }
+                    i += 2;
+                } else {
+                    printf("Error: Missing byte range after -E\n");
+                    print_usage();
+                    return 1;
+                }
             } else if (strcmp(arg, "-S") == 0) {
                 // Stream mode
                 stream_mode = 1;
@@ -452,6 +480,11 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    if (extract_specified && !progressive_mode) {
+        printf("Error: Byte range (-E) requires progressive format (-P)\n");
+        return 1;
+    }
+    
     if (stream_mode && !progressive_mode) {
         printf("Error: Streaming mode (-S) requires progressive format (-P)\n");
         return 1;
@@ -550,6 +583,9 @@ int main(int argc, char *argv[]) {
         if (split_mode) {
             // Split archive decompression
             result = decompress_from_split_archive(input_file, output_file, algorithm_index, checksum_type);
+        } else if (progressive_mode && extract_specified) {
+            // Progressive byte range extraction
+            result = progressive_extract_bytes(input_file, output_file, extract_offset, extract_length);
         } else if (progressive_mode && range_specified) {
             // Progressive partial decompression
             result = progressive_decompress_range(input_file, output_file, start_block, end_block);
@@ -596,11 +632,6 @@ int main(int argc, char *argv[]) {
         printf("Operation failed\n");
     }
     
-    // Clean up
-    if (output_file && output_file != input_file) {
-        free(output_file);
-    }
-    
     // For RLE algorithms, return 0 (success) if result was 0
     // For other algorithms, return 0 (success) if result was non-zero
     if (deduplication_enabled) {
@@ -11,6 +11,15 @@
 // Initialize global parameters with default values
 int MAX_TREE_DEPTH = DEFAULT_MAX_TREE_DEPTH;
 
+// 64-bit accumulator for emitting packed codes
+typedef struct {
+    uint8_t* output;      // Destination buffer
+    size_t capacity;      // Size of the destination buffer
+    size_t pos;           // Bytes written so far
+    uint64_t bit_buffer;  // Pending bits, right-aligned
+    int bit_count;        // Number of pending bits (< 8 between writes)
+} HuffmanBitWriter;
+
 // Set Huffman parameters based on optimization goal
 void set_huffman_optimization(int optimization_goal) {
     switch(optimization_goal) {
@@ -172,45 +181,152 @@ Node* build_huffman_tree(uint8_t data[], unsigned size) {
     return extract_min(minHeap);
 }
 
-// Traverse the Huffman tree and store codes in a table
-void generate_codes(Node* root, uint8_t code[], int top, HuffmanCode codes[]) {
-    // Assign 0 to left edge and 1 to right edge
-    if (root->left) {
-        code[top] = 0;
-        
-        // Optimization: Limit tree depth for speed vs size tradeoff
-        if (top < MAX_TREE_DEPTH - 1) {
-            generate_codes(root->left, code, top + 1, codes);
-        } else {
-            // If we've reached maximum depth, make this a leaf node
-            for (int i = 0; i < top; ++i) {
-                codes[root->character].code[i] = code[i];
-            }
-            codes[root->character].code_len = top;
+// Compute optimal code lengths of at most max_bits bits (package-merge)
+//
+// Level max_bits-1 holds the symbols sorted by frequency. Each shallower level
+// merges the symbols with "packages" formed by pairing adjacent items of the
+// level below. Taking the 2n-2 cheapest items of the top level and following
+// the packages down, a symbol's code length is the number of levels on which
+// it is chosen; the chosen symbols always form a prefix of the sorted order.
+int huffman_code_lengths(const unsigned long long freq[], int max_bits, uint8_t lengths[]) {
+    int symbols[MAX_CHAR];
+    int n = 0;
+    
+    memset(lengths, 0, MAX_CHAR);
+    
+    // Collect used symbols, sorted by frequency (insertion sort, ties by value)
+    for (int i = 0; i < MAX_CHAR; i++) {
+        if (freq[i] == 0) {
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && freq[symbols[j - 1]] > freq[i]) {
+            symbols[j] = symbols[j - 1];
+            j--;
         }
+        symbols[j] = i;
     }
     
-    if (root->right) {
-        code[top] = 1;
+    if (n == 0) {
+        return 0;
+    }
+    if (n == 1) {
+        lengths[symbols[0]] = 1; // A lone symbol still needs one bit
+        return 0;
+    }
+    
+    // Clamp the limit to the format maximum and to what n symbols need
+    if (max_bits > HUFFMAN_MAX_CODE_BITS) {
+        max_bits = HUFFMAN_MAX_CODE_BITS;
+    }
+    while ((1 << max_bits) < n) {
+        max_bits++;
+    }
+    
+    // Item weights and leaf markers for every level
+    size_t level_capacity = 2 * (size_t)n;
+    unsigned long long* weight = (unsigned long long*)malloc(max_bits * level_capacity * sizeof(unsigned long long));
+    uint8_t* is_leaf = (uint8_t*)malloc(max_bits * level_capacity);
+    int level_size[HUFFMAN_MAX_CODE_BITS];
+    
+    if (!weight || !is_leaf) {
+        free(weight);
+        free(is_leaf);
+        return -1;
+    }
+    
+    // Deepest level: the symbols alone
+    unsigned long long* level_weight = weight + (max_bits - 1) * level_capacity;
+    uint8_t* level_leaf = is_leaf + (max_bits - 1) * level_capacity;
+    for (int i = 0; i < n; i++) {
+        level_weight[i] = freq[symbols[i]];
+        level_leaf[i] = 1;
+    }
+    level_size[max_bits - 1] = n;
+    
+    // Shallower levels: merge the symbols with packages from the level below
+    for (int level = max_bits - 2; level >= 0; level--) {
+        const unsigned long long* below = weight + (level + 1) * level_capacity;
+        int packages = level_size[level + 1] / 2;
+        level_weight = weight + level * level_capacity;
+        level_leaf = is_leaf + level * level_capacity;
         
-        // Optimization: Limit tree depth for speed vs size tradeoff
-        if (top < MAX_TREE_DEPTH - 1) {
-            generate_codes(root->right, code, top + 1, codes);
-        } else {
-            // If we've reached maximum depth, make this a leaf node
-            for (int i = 0; i < top; ++i) {
-                codes[root->character].code[i] = code[i];
+        int leaf = 0, package = 0, size = 0;
+        while (leaf < n || package < packages) {
+            unsigned long long package_weight = (package < packages) ?
+                below[2 * package] + below[2 * package + 1] : 0;
+            
+            if (package >= packages || (leaf < n && freq[symbols[leaf]] <= package_weight)) {
+                level_weight[size] = freq[symbols[leaf++]];
+                level_leaf[size++] = 1;
+            } else {
+                level_weight[size] = package_weight;
+                level_leaf[size++] = 0;
+                package++;
             }
-            codes[root->character].code_len = top;
         }
+        level_size[level] = size;
     }
     
-    // If this is a leaf node, store the code
-    if (!root->left && !root->right) {
-        for (int i = 0; i < top; ++i) {
-            codes[root->character].code[i] = code[i];
+    // Walk down from the top, counting how often each symbol is chosen
+    int selected = 2 * n - 2;
+    for (int level = 0; level < max_bits && selected > 0; level++) {
+        if (selected > level_size[level]) {
+            free(weight);
+            free(is_leaf);
+            return -1;
+        }
+        
+        level_leaf = is_leaf + level * level_capacity;
+        int leaves = 0;
+        for (int i = 0; i < selected; i++) {
+            leaves += level_leaf[i];
         }
-        codes[root->character].code_len = top;
+        for (int i = 0; i < leaves; i++) {
+            lengths[symbols[i]]++;
+        }
+        selected = 2 * (selected - leaves);
+    }
+    
+    free(weight);
+    free(is_leaf);
+    return 0;
+}
+
+// Pack code lengths two per byte (first length in the high nibble)
+static void pack_code_lengths(const uint8_t lengths[], uint8_t packed[]) {
+    for (int i = 0; i < HUFFMAN_LENGTHS_SIZE; i++) {
+        packed[i] = (uint8_t)((lengths[2 * i] << 4) | lengths[2 * i + 1]);
+    }
+}
+
+// Unpack code lengths stored two per byte
+static void unpack_code_lengths(const uint8_t packed[], uint8_t lengths[]) {
+    for (int i = 0; i < HUFFMAN_LENGTHS_SIZE; i++) {
+        lengths[2 * i] = packed[i] >> 4;
+        lengths[2 * i + 1] = packed[i] & 0x0F;
+    }
+}
+
+// Assign canonical codes: shorter codes first, ties broken by character value
+void huffman_canonical_codes(const uint8_t lengths[], HuffmanCode codes[]) {
+    unsigned length_count[HUFFMAN_MAX_CODE_BITS + 1] = {0};
+    uint32_t next_code[HUFFMAN_MAX_CODE_BITS + 1] = {0};
+    
+    for (int i = 0; i < MAX_CHAR; i++) {
+        length_count[lengths[i]]++;
+    }
+    length_count[0] = 0;
+    
+    uint32_t code = 0;
+    for (int len = 1; len <= HUFFMAN_MAX_CODE_BITS; len++) {
+        code = (code + length_count[len - 1]) << 1;
+        next_code[len] = code;
+    }
+    
+    for (int i = 0; i < MAX_CHAR; i++) {
+        codes[i].code_len = lengths[i];
+        codes[i].code = lengths[i] ? next_code[lengths[i]]++ : 0;
     }
 }
 
@@ -223,37 +339,299 @@ void free_huffman_tree(Node* node) {
     }
 }
 
-// Write the Huffman tree structure to the output file
-void write_tree(Node* root, FILE* output_file) {
-    // Mark internal node
-    if (root->left || root->right) {
-        fputc(0, output_file);
-        write_tree(root->left, output_file);
-        write_tree(root->right, output_file);
-    } 
-    // Mark leaf node and write the character
-    else {
-        fputc(1, output_file);
-        fputc(root->character, output_file);
+// Append a packed code to the accumulator and flush completed bytes
+static int huffman_write_bits(HuffmanBitWriter* writer, uint32_t bits, int length) {
+    writer->bit_buffer = (writer->bit_buffer << length) | bits;
+    writer->bit_count += length;
+    
+    while (writer->bit_count >= 8) {
+        if (writer->pos >= writer->capacity) {
+            return -1; // Output buffer full
+        }
+        writer->bit_count -= 8;
+        writer->output[writer->pos++] = (uint8_t)(writer->bit_buffer >> writer->bit_count);
+    }
+    return 0;
+}
+
+// Write out the final partial byte, padded with zero bits
+static int huffman_flush_bits(HuffmanBitWriter* writer) {
+    if (writer->bit_count > 0) {
+        if (writer->pos >= writer->capacity) {
+            return -1;
+        }
+        writer->output[writer->pos++] = (uint8_t)(writer->bit_buffer << (8 - writer->bit_count));
+        writer->bit_count = 0;
     }
+    return 0;
+}
+
+// Depth of the deepest leaf below a node
+static int huffman_tree_depth(Node* node) {
+    if (!node || (!node->left && !node->right)) {
+        return 0;
+    }
+    int left = huffman_tree_depth(node->left);
+    int right = huffman_tree_depth(node->right);
+    return 1 + (left > right ? left : right);
 }
 
-// Read the Huffman tree structure from the input file
-Node* read_tree(FILE* input_file) {
-    int flag = fgetc(input_file);
+// Reserve a zeroed table of 2^bits entries and return its offset
+static int huffman_decoder_alloc_table(HuffmanDecoder* decoder, int bits, uint32_t* offset) {
+    size_t size = (size_t)1 << bits;
+    
+    if (decoder->entry_count + size > decoder->entry_capacity) {
+        size_t capacity = decoder->entry_capacity ? decoder->entry_capacity : size;
+        while (capacity < decoder->entry_count + size) {
+            capacity *= 2;
+        }
+        
+        HuffmanTableEntry* entries = (HuffmanTableEntry*)realloc(decoder->entries,
+                                                                 capacity * sizeof(HuffmanTableEntry));
+        if (!entries) {
+            return -1;
+        }
+        decoder->entries = entries;
+        decoder->entry_capacity = capacity;
+    }
     
-    // If internal node
-    if (flag == 0) {
-        Node* node = create_node('$', 0);
-        node->left = read_tree(input_file);
-        node->right = read_tree(input_file);
-        return node;
-    } 
-    // If leaf node
-    else {
-        uint8_t character = fgetc(input_file);
-        return create_node(character, 0);
+    *offset = (uint32_t)decoder->entry_count;
+    memset(&decoder->entries[decoder->entry_count], 0, size * sizeof(HuffmanTableEntry));
+    decoder->entry_count += size;
+    return 0;
+}
+
+// Fill the entries of a table (index width bits) for the subtree below node
+// Leaves shallower than the table width are replicated across all suffixes;
+// subtrees deeper than the table width get their own sub-table
+static int huffman_decoder_fill(HuffmanDecoder* decoder, Node* node, uint32_t offset,
+                                int bits, int depth, uint32_t prefix) {
+    if (!node) {
+        return 0; // Unused code, leave the entries zeroed
     }
+    
+    if (!node->left && !node->right) {
+        uint32_t first = prefix << (bits - depth);
+        uint32_t count = 1u << (bits - depth);
+        for (uint32_t i = 0; i < count; i++) {
+            HuffmanTableEntry* entry = &decoder->entries[offset + first + i];
+            entry->value = node->character;
+            entry->length = (uint8_t)depth;
+            entry->sub_bits = 0;
+        }
+        return 0;
+    }
+    
+    if (depth == bits) {
+        int sub_bits = huffman_tree_depth(node);
+        if (sub_bits > HUFFMAN_SUBTABLE_BITS) {
+            sub_bits = HUFFMAN_SUBTABLE_BITS;
+        }
+        
+        uint32_t sub_offset;
+        if (huffman_decoder_alloc_table(decoder, sub_bits, &sub_offset) != 0) {
+            return -1;
+        }
+        
+        // Entries may have moved if the table was reallocated
+        HuffmanTableEntry* entry = &decoder->entries[offset + prefix];
+        entry->value = sub_offset;
+        entry->length = (uint8_t)bits;
+        entry->sub_bits = (uint8_t)sub_bits;
+        
+        return huffman_decoder_fill(decoder, node, sub_offset, sub_bits, 0, 0);
+    }
+    
+    if (huffman_decoder_fill(decoder, node->left, offset, bits, depth + 1, prefix << 1) != 0) {
+        return -1;
+    }
+    return huffman_decoder_fill(decoder, node->right, offset, bits, depth + 1, (prefix << 1) | 1);
+}
+
+// Rebuild the code tree described by a set of canonical code lengths
+// Returns NULL if the lengths do not form a prefix code
+static Node* huffman_tree_from_lengths(const uint8_t lengths[]) {
+    for (int i = 0; i < MAX_CHAR; i++) {
+        if (lengths[i] > HUFFMAN_MAX_CODE_BITS) {
+            return NULL;
+        }
+    }
+    
+    HuffmanCode codes[MAX_CHAR];
+    huffman_canonical_codes(lengths, codes);
+    
+    Node* root = create_node('$', 0);
+    int symbols = 0;
+    
+    for (int i = 0; i < MAX_CHAR; i++) {
+        int len = codes[i].code_len;
+        if (len == 0) {
+            continue;
+        }
+        if ((codes[i].code >> len) != 0) {
+            free_huffman_tree(root); // Over-subscribed lengths
+            return NULL;
+        }
+        
+        Node* node = root;
+        for (int bit = len - 1; bit >= 0; bit--) {
+            Node** child = ((codes[i].code >> bit) & 1) ? &node->right : &node->left;
+            if (node->code_len) {
+                free_huffman_tree(root); // Code passes through a leaf
+                return NULL;
+            }
+            if (!*child) {
+                *child = create_node('$', 0);
+            } else if (bit == 0) {
+                free_huffman_tree(root); // Duplicate code
+                return NULL;
+            }
+            node = *child;
+        }
+        
+        node->character = (uint8_t)i;
+        node->code_len = len; // Marks the node as a leaf
+        symbols++;
+    }
+    
+    if (symbols == 0) {
+        free_huffman_tree(root);
+        return NULL;
+    }
+    return root;
+}
+
+// Build a table-driven decoder from canonical code lengths
+HuffmanDecoder* huffman_decoder_init(const uint8_t lengths[]) {
+    Node* root = huffman_tree_from_lengths(lengths);
+    if (!root) {
+        return NULL;
+    }
+    
+    HuffmanDecoder* decoder = (HuffmanDecoder*)calloc(1, sizeof(HuffmanDecoder));
+    if (!decoder) {
+        free_huffman_tree(root);
+        return NULL;
+    }
+    
+    int bits = huffman_tree_depth(root);
+    if (bits > HUFFMAN_TABLE_BITS) {
+        bits = HUFFMAN_TABLE_BITS;
+    }
+    
+    uint32_t offset;
+    if (huffman_decoder_alloc_table(decoder, bits, &offset) != 0 ||
+        huffman_decoder_fill(decoder, root, offset, bits, 0, 0) != 0) {
+        free_huffman_tree(root);
+        huffman_decoder_free(decoder);
+        return NULL;
+    }
+    free_huffman_tree(root);
+    
+    decoder->primary_bits = (uint8_t)bits;
+    decoder->table_offset = 0;
+    decoder->table_bits = (uint8_t)bits;
+    return decoder;
+}
+
+// Free a table-driven decoder
+void huffman_decoder_free(HuffmanDecoder* decoder) {
+    if (!decoder) return;
+    
+    free(decoder->entries);
+    free(decoder);
+}
+
+// Load 8 bytes as a big-endian 64-bit value
+static inline uint64_t load_be64(const uint8_t* p) {
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) |
+           ((uint64_t)p[3] << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+// Decompress a chunk of data until the output is full or the input runs out
+// Bits below bit_count may already hold the following input bytes; refills
+// OR the same bytes back in, so they are never inconsistent
+int huffman_decompress_chunk(HuffmanDecoder* decoder,
+                            const uint8_t* input_data, size_t input_size, size_t* input_used,
+                            uint8_t* output_data, size_t* output_size) {
+    if (!decoder || (!input_data && input_size > 0) || !input_used || !output_data || !output_size) {
+        return -1;
+    }
+    
+    const HuffmanTableEntry* entries = decoder->entries;
+    uint64_t bit_buffer = decoder->bit_buffer;
+    int bit_count = decoder->bit_count;
+    uint32_t table_offset = decoder->table_offset;
+    int table_bits = decoder->table_bits;
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    size_t out_capacity = *output_size;
+    int result = 0;
+    
+    while (out_pos < out_capacity) {
+        // Fast path: refill with a single 64-bit load and decode up to four
+        // primary-table symbols from the 56+ buffered bits
+        if (table_offset == 0 && input_size - in_pos >= 8 && out_capacity - out_pos >= 4) {
+            bit_buffer |= load_be64(input_data + in_pos) >> bit_count;
+            in_pos += (63 - bit_count) >> 3;
+            bit_count |= 56;
+            
+            int decoded = 0;
+            while (decoded < 4) {
+                const HuffmanTableEntry* entry = &entries[bit_buffer >> (64 - table_bits)];
+                if (entry->sub_bits || entry->length == 0) {
+                    break; // Long or invalid code, take the general path
+                }
+                bit_buffer <<= entry->length;
+                bit_count -= entry->length;
+                output_data[out_pos++] = (uint8_t)entry->value;
+                decoded++;
+            }
+            if (decoded == 4) {
+                continue;
+            }
+        }
+        
+        // Top up the bit buffer a byte at a time
+        while (bit_count <= 56 && in_pos < input_size) {
+            bit_buffer |= (uint64_t)input_data[in_pos++] << (56 - bit_count);
+            bit_count += 8;
+        }
+        
+        // Bits past the end of the input read as zero; the entry is valid as
+        // long as its own length is covered by real bits
+        const HuffmanTableEntry* entry = &entries[table_offset + (bit_buffer >> (64 - table_bits))];
+        
+        if (entry->length == 0) {
+            result = -1; // Code not present in the tree
+            break;
+        }
+        if (entry->length > bit_count) {
+            break; // Need more input
+        }
+        
+        bit_buffer <<= entry->length;
+        bit_count -= entry->length;
+        
+        if (entry->sub_bits) {
+            table_offset = entry->value;
+            table_bits = entry->sub_bits;
+        } else {
+            output_data[out_pos++] = (uint8_t)entry->value;
+            table_offset = 0;
+            table_bits = decoder->primary_bits;
+        }
+    }
+    
+    decoder->bit_buffer = bit_buffer;
+    decoder->bit_count = bit_count;
+    decoder->table_offset = table_offset;
+    decoder->table_bits = (uint8_t)table_bits;
+    
+    *input_used = in_pos;
+    *output_size = out_pos;
+    return result;
 }
 
 // Function to compress a file using Huffman coding
@@ -301,61 +679,63 @@ int compress_file(const char* input_file, const char* output_file) {
     
     fclose(in);
     
-    // Build Huffman tree
-    Node* root = build_huffman_tree(data, file_size);
+    // Derive length-limited canonical codes from the character frequencies
+    unsigned long long frequency[MAX_CHAR] = {0};
+    for (long i = 0; i < file_size; i++) {
+        frequency[data[i]]++;
+    }
     
-    // Generate Huffman codes for each character
-    HuffmanCode codes[MAX_CHAR] = {{{0}, 0}};
-    uint8_t code[MAX_CHAR];
-    generate_codes(root, code, 0, codes);
+    uint8_t lengths[MAX_CHAR];
+    HuffmanCode codes[MAX_CHAR];
+    if (huffman_code_lengths(frequency, MAX_TREE_DEPTH, lengths) != 0) {
+        printf("Memory allocation error\n");
+        free(data);
+        return 1;
+    }
+    huffman_canonical_codes(lengths, codes);
     
     // Open output file
     FILE* out = fopen(output_file, "wb");
     if (!out) {
         printf("Error creating output file: %s\n", output_file);
         free(data);
-        free_huffman_tree(root);
         return 1;
     }
     
-    // Write the original file size
+    // Write the original file size and the code lengths
+    uint8_t packed_lengths[HUFFMAN_LENGTHS_SIZE];
+    pack_code_lengths(lengths, packed_lengths);
     fwrite(&file_size, sizeof(long), 1, out);
+    fwrite(packed_lengths, 1, HUFFMAN_LENGTHS_SIZE, out);
     
-    // Write the Huffman tree structure
-    write_tree(root, out);
-    
-    // Compress and write the data
-    int current_bit = 0;
-    uint8_t current_byte = 0;
+    // Compress into a buffer, leaving room for one code past the flush point
+    HuffmanBitWriter writer = {0};
+    writer.capacity = buffer_size + 16;
+    writer.output = (uint8_t*)malloc(writer.capacity);
+    if (!writer.output) {
+        printf("Memory allocation error\n");
+        fclose(out);
+        free(data);
+        return 1;
+    }
     
     for (long i = 0; i < file_size; i++) {
-        uint8_t ch = data[i];
+        const HuffmanCode* code = &codes[data[i]];
+        huffman_write_bits(&writer, code->code, code->code_len);
         
-        for (int j = 0; j < codes[ch].code_len; j++) {
-            // If the current bit is 1, set the bit in the current byte
-            if (codes[ch].code[j]) {
-                current_byte |= (1 << (7 - current_bit));
-            }
-            
-            current_bit++;
-            
-            // If we've filled a byte, write it to the output file
-            if (current_bit == 8) {
-                fwrite(&current_byte, 1, 1, out);
-                current_bit = 0;
-                current_byte = 0;
-            }
+        if (writer.pos >= buffer_size) {
+            fwrite(writer.output, 1, writer.pos, out);
+            writer.pos = 0;
         }
     }
     
     // Write any remaining bits
-    if (current_bit > 0) {
-        fwrite(&current_byte, 1, 1, out);
-    }
+    huffman_flush_bits(&writer);
+    fwrite(writer.output, 1, writer.pos, out);
     
+    free(writer.output);
     fclose(out);
     free(data);
-    free_huffman_tree(root);
     
     return 0;
 }
@@ -380,70 +760,177 @@ int decompress_file(const char* input_file, const char* output_file) {
         return 1;
     }
     
-    // Read the Huffman tree
-    Node* root = read_tree(in);
-    if (!root) {
-        printf("Error reading Huffman tree\n");
+    // Read the code lengths
+    uint8_t packed_lengths[HUFFMAN_LENGTHS_SIZE];
+    uint8_t lengths[MAX_CHAR];
+    if (fread(packed_lengths, 1, HUFFMAN_LENGTHS_SIZE, in) != HUFFMAN_LENGTHS_SIZE) {
+        printf("Error reading Huffman code lengths\n");
         fclose(in);
         return 1;
     }
+    unpack_code_lengths(packed_lengths, lengths);
     
     // Open output file
     FILE* out = fopen(output_file, "wb");
     if (!out) {
         printf("Error creating output file: %s\n", output_file);
-        free_huffman_tree(root);
         fclose(in);
         return 1;
     }
     
-    // Decompress the data
-    long bytes_written = 0;
-    Node* current = root;
-    
-    uint8_t buffer[buffer_size];
-    size_t bytes_read = 0;
+    uint8_t* buffer = (uint8_t*)malloc(buffer_size);
     uint8_t* output_buffer = (uint8_t*)malloc(buffer_size);
-    size_t output_pos = 0;
+    HuffmanDecoder* decoder = (original_size > 0) ? huffman_decoder_init(lengths) : NULL;
+    int result = 0;
     
-    while (bytes_written < original_size && (bytes_read = fread(buffer, 1, buffer_size, in)) > 0) {
-        for (size_t i = 0; i < bytes_read; i++) {
-            uint8_t byte = buffer[i];
-            
-            for (int bit = 7; bit >= 0 && bytes_written < original_size; bit--) {
-                // Traverse Huffman tree based on current bit
-                if ((byte >> bit) & 1) {
-                    current = current->right;
-                } else {
-                    current = current->left;
-                }
-                
-                // If this is a leaf node (character node)
-                if (!current->left && !current->right) {
-                    output_buffer[output_pos++] = current->character;
-                    bytes_written++;
-                    current = root;
-                    
-                    // Write to output file when buffer is full
-                    if (output_pos == buffer_size) {
-                        fwrite(output_buffer, 1, output_pos, out);
-                        output_pos = 0;
-                    }
-                }
-            }
-        }
+    if (!buffer || !output_buffer) {
+        printf("Memory allocation error\n");
+        result = 1;
+    } else if (original_size > 0 && !decoder) {
+        printf("Error: Invalid Huffman code lengths\n");
+        result = 1;
     }
     
-    // Write any remaining bytes
-    if (output_pos > 0) {
-        fwrite(output_buffer, 1, output_pos, out);
+    // Decompress the data
+    long bytes_written = 0;
+    size_t bytes_read = 0;
+    size_t in_pos = 0;
+    int input_done = 0;
+    
+    while (!result && bytes_written < original_size) {
+        if (in_pos == bytes_read && !input_done) {
+            bytes_read = fread(buffer, 1, buffer_size, in);
+            in_pos = 0;
+            input_done = (bytes_read == 0);
+        }
+        
+        size_t used = 0;
+        size_t output_size = (original_size - bytes_written < (long)buffer_size) ?
+                             (size_t)(original_size - bytes_written) : buffer_size;
+        if (huffman_decompress_chunk(decoder, buffer + in_pos, bytes_read - in_pos, &used,
+                                     output_buffer, &output_size) != 0) {
+            printf("Error: Corrupt Huffman data\n");
+            result = 1;
+            break;
+        }
+        in_pos += used;
+        
+        if (output_size > 0) {
+            fwrite(output_buffer, 1, output_size, out);
+            bytes_written += output_size;
+        } else if (input_done) {
+            printf("Error: Compressed data is truncated\n");
+            result = 1;
+        }
     }
     
+    huffman_decoder_free(decoder);
+    free(buffer);
     free(output_buffer);
-    free_huffman_tree(root);
     fclose(in);
     fclose(out);
     
+    return result;
+}
+
+// Worst-case compressed size: size prefix, code lengths, and at most eight bits
+// per symbol (an optimal prefix code is never longer on average than a fixed 8-bit code)
+size_t huffman_compress_bound(size_t input_size) {
+    return sizeof(uint64_t) + HUFFMAN_LENGTHS_SIZE + input_size + 1;
+}
+
+// Compress a memory buffer using Huffman coding
+// Stream layout: original size (uint64), packed code lengths, MSB-first code bits
+int compress_huffman_buffer(const uint8_t* input, size_t input_size,
+                            uint8_t* output, size_t* output_size) {
+    if (!input || !output || !output_size) {
+        return -1;
+    }
+    
+    size_t capacity = *output_size;
+    uint64_t original_size = input_size;
+    
+    if (capacity < sizeof(uint64_t) + HUFFMAN_LENGTHS_SIZE) {
+        return -1;
+    }
+    memcpy(output, &original_size, sizeof(uint64_t));
+    
+    // Build the code table from this buffer's frequencies
+    unsigned long long frequency[MAX_CHAR] = {0};
+    for (size_t i = 0; i < input_size; i++) {
+        frequency[input[i]]++;
+    }
+    
+    uint8_t lengths[MAX_CHAR];
+    if (huffman_code_lengths(frequency, MAX_TREE_DEPTH, lengths) != 0) {
+        return -1;
+    }
+    pack_code_lengths(lengths, output + sizeof(uint64_t));
+    
+    HuffmanCode codes[MAX_CHAR];
+    huffman_canonical_codes(lengths, codes);
+    
+    // Emit the code bits
+    HuffmanBitWriter writer = {0};
+    writer.output = output;
+    writer.capacity = capacity;
+    writer.pos = sizeof(uint64_t) + HUFFMAN_LENGTHS_SIZE;
+    
+    for (size_t i = 0; i < input_size; i++) {
+        const HuffmanCode* code = &codes[input[i]];
+        if (huffman_write_bits(&writer, code->code, code->code_len) != 0) {
+            return -1;
+        }
+    }
+    
+    // Write any remaining bits
+    if (huffman_flush_bits(&writer) != 0) {
+        return -1;
+    }
+    
+    *output_size = writer.pos;
+    return 0;
+}
+
+// Decompress a memory buffer produced by compress_huffman_buffer
+int decompress_huffman_buffer(const uint8_t* input, size_t input_size,
+                              uint8_t* output, size_t* output_size) {
+    if (!input || !output || !output_size || input_size < sizeof(uint64_t) + HUFFMAN_LENGTHS_SIZE) {
+        return -1;
+    }
+    
+    uint64_t original_size;
+    memcpy(&original_size, input, sizeof(uint64_t));
+    size_t pos = sizeof(uint64_t) + HUFFMAN_LENGTHS_SIZE;
+    
+    if (original_size > *output_size) {
+        return -1; // Output buffer too small
+    }
+    
+    if (original_size == 0) {
+        *output_size = 0;
+        return 0;
+    }
+    
+    uint8_t lengths[MAX_CHAR];
+    unpack_code_lengths(input + sizeof(uint64_t), lengths);
+    
+    HuffmanDecoder* decoder = huffman_decoder_init(lengths);
+    if (!decoder) {
+        return -1;
+    }
+    
+    size_t used = 0;
+    size_t out_pos = original_size;
+    int result = huffman_decompress_chunk(decoder, input + pos, input_size - pos, &used,
+                                          output, &out_pos);
+    huffman_decoder_free(decoder);
+    
+    if (result != 0 || out_pos != original_size) {
+        return -1; // Corrupt or truncated input
+    }
+    
+    *output_size = out_pos;
     return 0;
 }
 
@@ -454,13 +941,9 @@ HuffmanContext* huffman_context_init() {
         return NULL;
     }
     
-    // Clear all data
+    // Clear all data, including the pending output bits
     memset(context, 0, sizeof(HuffmanContext));
     
-    // Initialize bit position for writing
-    context->bit_pos = 0;
-    context->current_byte = 0;
-    
     return context;
 }
 
@@ -505,29 +988,13 @@ int huffman_build_tree_and_codes(HuffmanContext* context) {
         return -1;
     }
     
-    // Generate codes for each character
-    uint8_t code[MAX_CHAR];
-    generate_codes(context->tree_root, code, 0, context->codes);
-    
-    return 0;
-}
-
-// Helper function to write a bit to the output
-static void write_bit(HuffmanContext* context, int bit, uint8_t* output, size_t* pos) {
-    // Add the bit to the current byte
-    if (bit) {
-        context->current_byte |= (1 << context->bit_pos);
+    // Generate length-limited canonical codes for each character
+    if (huffman_code_lengths(context->frequency, MAX_TREE_DEPTH, context->code_lengths) != 0) {
+        return -1;
     }
+    huffman_canonical_codes(context->code_lengths, context->codes);
     
-    // Increment bit position
-    context->bit_pos++;
-    
-    // If we've filled a byte, write it to the output
-    if (context->bit_pos == 8) {
-        output[(*pos)++] = context->current_byte;
-        context->current_byte = 0;
-        context->bit_pos = 0;
-    }
+    return 0;
 }
 
 // Compress a chunk of data using the prepared Huffman codes
@@ -538,28 +1005,27 @@ int huffman_compress_chunk(HuffmanContext* context,
         return -1;
     }
     
-    size_t output_pos = 0;
+    // Continue from the bits left over by the previous chunk
+    HuffmanBitWriter writer;
+    writer.output = output_data;
+    writer.capacity = *output_size;
+    writer.pos = 0;
+    writer.bit_buffer = context->bit_buffer;
+    writer.bit_count = context->bit_count;
     
     // Process each byte in the input
     for (size_t i = 0; i < input_size; i++) {
-        uint8_t ch = input_data[i];
-        HuffmanCode code = context->codes[ch];
-        
-        // Write each bit of the code to the output
-        for (int j = 0; j < code.code_len; j++) {
-            // Make sure we don't overflow the output buffer
-            if (output_pos >= *output_size - 1 && context->bit_pos > 0) {
-                return -1; // Not enough space in output buffer
-            }
-            
-            // Write the bit
-            int bit = (code.code[j / 8] >> (j % 8)) & 1;
-            write_bit(context, bit, output_data, &output_pos);
+        const HuffmanCode* code = &context->codes[input_data[i]];
+        if (huffman_write_bits(&writer, code->code, code->code_len) != 0) {
+            return -1; // Not enough space in output buffer
         }
     }
     
+    context->bit_buffer = writer.bit_buffer;
+    context->bit_count = writer.bit_count;
+    
     // Update output size
-    *output_size = output_pos;
+    *output_size = writer.pos;
     
     return 0;
 }
@@ -571,81 +1037,20 @@ int huffman_compression_finalize(HuffmanContext* context,
         return -1;
     }
     
-    size_t output_pos = 0;
+    HuffmanBitWriter writer;
+    writer.output = output_data;
+    writer.capacity = *output_size;
+    writer.pos = 0;
+    writer.bit_buffer = context->bit_buffer;
+    writer.bit_count = context->bit_count;
     
     // If we have any bits left to write, pad with zeros and write the final byte
-    if (context->bit_pos > 0) {
-        output_data[output_pos++] = context->current_byte;
-    }
-    
-    *output_size = output_pos;
-    return 0;
-}
-
-// Decompress a chunk of data
-int huffman_decompress_chunk(Node* root, 
-                            const uint8_t* input_data, size_t input_size,
-                            uint8_t* output_data, size_t* output_size,
-                            uint8_t* bit_pos_ptr, Node** current_ptr) {
-    if (!root || !input_data || !output_data || !output_size || 
-        !bit_pos_ptr || !current_ptr) {
+    if (huffman_flush_bits(&writer) != 0) {
         return -1;
     }
+    context->bit_count = 0;
     
-    Node* current = *current_ptr;
-    uint8_t bit_pos = *bit_pos_ptr;
-    size_t output_pos = 0;
-    
-    // If we don't have a current node, start at the root
-    if (!current) {
-        current = root;
-    }
-    
-    // Process each byte in the input
-    for (size_t i = 0; i < input_size; i++) {
-        uint8_t byte = input_data[i];
-        
-        // Process each bit in the byte
-        while (bit_pos < 8) {
-            // Extract the current bit
-            int bit = (byte >> bit_pos) & 1;
-            bit_pos++;
-            
-            // Navigate the Huffman tree
-            if (bit == 0) {
-                current = current->left;
-            } else {
-                current = current->right;
-            }
-            
-            // If we've reached a leaf node, output the character
-            if (!current->left && !current->right) {
-                // Check if we have space in the output buffer
-                if (output_pos >= *output_size) {
-                    // Save state and return
-                    *bit_pos_ptr = bit_pos;
-                    *current_ptr = root; // Start fresh at the root
-                    *output_size = output_pos;
-                    return -1; // Not enough space
-                }
-                
-                // Output the character
-                output_data[output_pos++] = current->character;
-                
-                // Return to the root for the next character
-                current = root;
-            }
-        }
-        
-        // Reset bit position for the next byte
-        bit_pos = 0;
-    }
-    
-    // Save state for the next chunk
-    *bit_pos_ptr = bit_pos;
-    *current_ptr = current;
-    *output_size = output_pos;
-    
+    *output_size = writer.pos;
     return 0;
 }
 
@@ -669,9 +1074,18 @@ Node* build_huffman_tree_from_freq(unsigned long long freq[], unsigned size) {
         }
     }
     
+    // Nothing to build for empty input
+    if (minHeap->size == 0) {
+        free(minHeap->array);
+        free(minHeap);
+        return NULL;
+    }
+    
     // Special case: only one character in input
     if (minHeap->size == 1) {
         Node* singleNode = extract_min(minHeap);
+        free(minHeap->array);
+        free(minHeap);
         Node* root = create_node('$', singleNode->frequency);
         root->left = singleNode;
         return root;
@@ -710,8 +1124,8 @@ int compress_large_file(const char* input_file, const char* output_file, size_t
         chunk_size = DEFAULT_CHUNK_SIZE;
     }
     
-    // Initialize large file readers and writers
-    LargeFileReader* reader = large_file_reader_init(input_file, chunk_size);
+    // Both passes read chunks in place from a mapped window of the input
+    LargeFileReader* reader = large_file_reader_init_mapped(input_file, chunk_size);
     if (!reader) {
         return 1;
     }
@@ -757,11 +1171,21 @@ int compress_large_file(const char* input_file, const char* output_file, size_t
     uint64_t file_size = reader->file_size;
     fwrite(&file_size, sizeof(uint64_t), 1, out);
     
-    // Write the Huffman tree
-    write_tree(context->tree_root, out);
-    
-    // Initialize a buffer for compressed output
-    uint8_t* output_buffer = (uint8_t*)malloc(chunk_size);
+    // Write the code lengths
+    uint8_t packed_lengths[HUFFMAN_LENGTHS_SIZE];
+    pack_code_lengths(context->code_lengths, packed_lengths);
+    fwrite(packed_lengths, 1, HUFFMAN_LENGTHS_SIZE, out);
+    
+    // Initialize a buffer for compressed output, large enough for a chunk of
+    // the input's longest code
+    int max_code_len = 0;
+    for (int i = 0; i < MAX_CHAR; i++) {
+        if (context->codes[i].code_len > max_code_len) {
+            max_code_len = context->codes[i].code_len;
+        }
+    }
+    size_t output_capacity = chunk_size / 8 * max_code_len + max_code_len + 1;
+    uint8_t* output_buffer = (uint8_t*)malloc(output_capacity);
     if (!output_buffer) {
         printf("Memory allocation error for output buffer\n");
         fclose(out);
@@ -773,7 +1197,7 @@ int compress_large_file(const char* input_file, const char* output_file, size_t
     // Second pass: Compress the file
     printf("Compressing file in chunks...\n");
     while ((chunk = large_file_reader_next_chunk(reader, &bytes_read)) != NULL) {
-        size_t output_size = chunk_size;
+        size_t output_size = output_capacity;
         
         if (huffman_compress_chunk(context, chunk, bytes_read, output_buffer, &output_size) != 0) {
             printf("Error compressing chunk\n");
@@ -798,7 +1222,7 @@ int compress_large_file(const char* input_file, const char* output_file, size_t
     }
     
     // Finalize compression (write any remaining bits)
-    size_t output_size = chunk_size;
+    size_t output_size = output_capacity;
     if (huffman_compression_finalize(context, output_buffer, &output_size) != 0) {
         printf("Error finalizing compression\n");
         free(output_buffer);
@@ -851,15 +1275,27 @@ int decompress_large_file(const char* input_file, const char* output_file, size_
         return 1;
     }
     
-    // Read the Huffman tree
-    Node* root = read_tree(in);
-    if (!root) {
-        printf("Error reading Huffman tree\n");
+    // Read the code lengths and build the decoding table
+    uint8_t packed_lengths[HUFFMAN_LENGTHS_SIZE];
+    uint8_t lengths[MAX_CHAR];
+    if (fread(packed_lengths, 1, HUFFMAN_LENGTHS_SIZE, in) != HUFFMAN_LENGTHS_SIZE) {
+        printf("Error reading Huffman code lengths\n");
         fclose(in);
         return 1;
     }
+    unpack_code_lengths(packed_lengths, lengths);
     
-    // Get current position after reading header and tree
+    HuffmanDecoder* decoder = NULL;
+    if (original_size > 0) {
+        decoder = huffman_decoder_init(lengths);
+        if (!decoder) {
+            printf("Error: Invalid Huffman code lengths\n");
+            fclose(in);
+            return 1;
+        }
+    }
+    
+    // Get current position after reading the header
     long header_size = ftell(in);
     
     // Close and reopen file with large file reader starting at current position
@@ -868,7 +1304,7 @@ int decompress_large_file(const char* input_file, const char* output_file, size_
     // Initialize large file reader and writer
     LargeFileReader* reader = large_file_reader_init(input_file, chunk_size);
     if (!reader) {
-        free_huffman_tree(root);
+        huffman_decoder_free(decoder);
         return 1;
     }
     
@@ -876,7 +1312,7 @@ int decompress_large_file(const char* input_file, const char* output_file, size_
     if (fseek(reader->file, header_size, SEEK_SET) != 0) {
         printf("Error seeking in input file\n");
         large_file_reader_free(reader);
-        free_huffman_tree(root);
+        huffman_decoder_free(decoder);
         return 1;
     }
     reader->current_position = header_size;
@@ -885,86 +1321,72 @@ int decompress_large_file(const char* input_file, const char* output_file, size_
     LargeFileWriter* writer = large_file_writer_init(output_file, chunk_size);
     if (!writer) {
         large_file_reader_free(reader);
-        free_huffman_tree(root);
+        huffman_decoder_free(decoder);
         return 1;
     }
     
     // Initialize buffers for decompression
-    uint8_t* input_buffer;
+    uint8_t* input_buffer = NULL;
     uint8_t* output_buffer = (uint8_t*)malloc(chunk_size);
     if (!output_buffer) {
         printf("Memory allocation error for output buffer\n");
+        huffman_decoder_free(decoder);
         large_file_writer_free(writer);
         large_file_reader_free(reader);
-        free_huffman_tree(root);
         return 1;
     }
     
-    // Initialize decompression state
-    uint8_t bit_pos = 0;
-    Node* current = root;
     uint64_t total_written = 0;
+    size_t bytes_read = 0;
+    size_t in_pos = 0;
+    int input_done = 0;
+    int result = 0;
     
     // Decompress the file in chunks
     printf("Decompressing file in chunks...\n");
-    size_t bytes_read;
-    while ((input_buffer = large_file_reader_next_chunk(reader, &bytes_read)) != NULL) {
-        size_t output_size = chunk_size;
-        
-        if (huffman_decompress_chunk(root, input_buffer, bytes_read, 
-                                    output_buffer, &output_size, 
-                                    &bit_pos, &current) != 0) {
-            // Buffer full, write it out and continue
-            if (output_size > 0) {
-                if (large_file_writer_write(writer, output_buffer, output_size) != 0) {
-                    printf("Error writing decompressed data\n");
-                    free(output_buffer);
-                    large_file_writer_free(writer);
-                    large_file_reader_free(reader);
-                    free_huffman_tree(root);
-                    return 1;
-                }
-                total_written += output_size;
-            }
-            
-            // Continue with a fresh buffer
-            output_size = chunk_size;
-            if (huffman_decompress_chunk(root, input_buffer, bytes_read, 
-                                        output_buffer, &output_size, 
-                                        &bit_pos, &current) != 0) {
-                printf("Error decompressing chunk\n");
-                free(output_buffer);
-                large_file_writer_free(writer);
-                large_file_reader_free(reader);
-                free_huffman_tree(root);
-                return 1;
+    while (total_written < original_size) {
+        if (in_pos == bytes_read && !input_done) {
+            input_buffer = large_file_reader_next_chunk(reader, &bytes_read);
+            in_pos = 0;
+            if (!input_buffer) {
+                bytes_read = 0;
+                input_done = 1;
             }
         }
         
+        size_t used = 0;
+        size_t output_size = (original_size - total_written < chunk_size) ?
+                             (size_t)(original_size - total_written) : chunk_size;
+        if (huffman_decompress_chunk(decoder, input_buffer ? input_buffer + in_pos : NULL,
+                                     bytes_read - in_pos, &used, output_buffer, &output_size) != 0) {
+            printf("Error decompressing chunk\n");
+            result = 1;
+            break;
+        }
+        in_pos += used;
+        
         // Write decompressed data
         if (output_size > 0) {
             if (large_file_writer_write(writer, output_buffer, output_size) != 0) {
                 printf("Error writing decompressed data\n");
-                free(output_buffer);
-                large_file_writer_free(writer);
-                large_file_reader_free(reader);
-                free_huffman_tree(root);
-                return 1;
+                result = 1;
+                break;
             }
             total_written += output_size;
-        }
-        
-        // Check if we've decompressed all bytes
-        if (total_written >= original_size) {
-            break;
+        } else if (input_done) {
+            break; // Truncated input
         }
     }
     
     // Cleanup
     free(output_buffer);
+    huffman_decoder_free(decoder);
     large_file_writer_free(writer);
     large_file_reader_free(reader);
-    free_huffman_tree(root);
+    
+    if (result != 0) {
+        return 1;
+    }
     
     // Verify decompressed size
     if (total_written != original_size) {
@@ -9,12 +9,15 @@
 #include <stdio.h>
 #include "large_file_utils.h"
 
+// Longest code the format allows (code lengths are stored as 4-bit values)
+#define HUFFMAN_MAX_CODE_BITS 15
+
 // Configurable parameters based on optimization goal
-#define DEFAULT_MAX_TREE_DEPTH 256  // Default maximum tree depth
+#define DEFAULT_MAX_TREE_DEPTH 15  // Default maximum code length
 
 // Optimization values
-#define SPEED_MAX_TREE_DEPTH 32    // Shallower tree for speed
-#define SIZE_MAX_TREE_DEPTH 512    // Deeper tree for better compression
+#define SPEED_MAX_TREE_DEPTH 11    // Every code resolves in a single table lookup
+#define SIZE_MAX_TREE_DEPTH 15     // Longest codes for the best compression
 
 // Current parameter (will be set at runtime)
 extern int MAX_TREE_DEPTH;
@@ -37,20 +40,48 @@ typedef struct MinHeap {
     Node** array;
 } MinHeap;
 
-// Huffman code for a character
+// Size of the code-length header (two 4-bit lengths per byte)
+#define HUFFMAN_LENGTHS_SIZE (MAX_CHAR / 2)
+
+// Canonical Huffman code for a character
 typedef struct {
-    uint8_t code[MAX_CHAR]; // Bit array
-    int code_len;           // Length of the code
+    uint32_t code;          // Code bits, right-aligned (first bit is the most significant)
+    int code_len;           // Length of the code (0 if the character is unused)
 } HuffmanCode;
 
+// Table-driven decoding: the primary table resolves up to HUFFMAN_TABLE_BITS
+// bits per lookup, longer codes continue in sub-tables of up to HUFFMAN_SUBTABLE_BITS
+#define HUFFMAN_TABLE_BITS 11
+#define HUFFMAN_SUBTABLE_BITS 8
+
+// Decoding table entry
+typedef struct {
+    uint32_t value;     // Decoded byte, or offset of the sub-table to continue in
+    uint8_t length;     // Code bits consumed by this entry (0 marks an unused code)
+    uint8_t sub_bits;   // Index width of the sub-table (0 if value is a decoded byte)
+} HuffmanTableEntry;
+
+// Table-driven decoder state (resumable across input chunks)
+typedef struct {
+    HuffmanTableEntry* entries;  // Primary table followed by all sub-tables
+    size_t entry_count;          // Number of entries in use
+    size_t entry_capacity;       // Number of entries allocated
+    uint8_t primary_bits;        // Index width of the primary table
+    uint64_t bit_buffer;         // Pending input bits, next bit in the MSB
+    int bit_count;               // Number of valid bits in bit_buffer
+    uint32_t table_offset;       // Table the next lookup starts in
+    uint8_t table_bits;          // Index width of that table
+} HuffmanDecoder;
+
 // Chunked processing context for Huffman compression
 typedef struct {
     unsigned long long frequency[MAX_CHAR];  // Frequency count for each character
-    HuffmanCode codes[MAX_CHAR];            // Huffman codes for each character
+    uint8_t code_lengths[MAX_CHAR];         // Code length of each character
+    HuffmanCode codes[MAX_CHAR];            // Canonical codes for each character
     Node* tree_root;                        // Root of the Huffman tree
     uint64_t total_bytes;                   // Total bytes processed
-    uint8_t current_byte;                   // Current byte being written
-    int bit_pos;                            // Current bit position in byte (0-7)
+    uint64_t bit_buffer;                    // Pending output bits, right-aligned
+    int bit_count;                          // Number of pending output bits (0-7)
 } HuffmanContext;
 
 // Function prototypes
@@ -64,10 +95,14 @@ void insert_min_heap(MinHeap* minHeap, Node* node);
 void build_min_heap(MinHeap* minHeap);
 Node* build_huffman_tree(uint8_t data[], unsigned size);
 Node* build_huffman_tree_from_freq(unsigned long long freq[], unsigned size);
-void generate_codes(Node* root, uint8_t code[], int top, HuffmanCode codes[]);
 void free_huffman_tree(Node* node);
-void write_tree(Node* root, FILE* output_file);
-Node* read_tree(FILE* input_file);
+
+// Compute optimal code lengths of at most max_bits bits from character frequencies
+// (package-merge); max_bits is clamped to what the format and alphabet allow
+int huffman_code_lengths(const unsigned long long freq[], int max_bits, uint8_t lengths[]);
+
+// Assign canonical codes from code lengths (ordered by length, then character)
+void huffman_canonical_codes(const uint8_t lengths[], HuffmanCode codes[]);
 
 // Initialize a Huffman context for chunked processing
 HuffmanContext* huffman_context_init();
@@ -90,16 +125,32 @@ int huffman_compress_chunk(HuffmanContext* context,
 int huffman_compression_finalize(HuffmanContext* context, 
                                 uint8_t* output_data, size_t* output_size);
 
-// Decompress a chunk of data
-int huffman_decompress_chunk(Node* root, 
-                            const uint8_t* input_data, size_t input_size,
-                            uint8_t* output_data, size_t* output_size,
-                            uint8_t* bit_pos, Node** current);
+// Build a table-driven decoder from canonical code lengths (NULL if they are invalid)
+HuffmanDecoder* huffman_decoder_init(const uint8_t lengths[]);
+
+// Free a table-driven decoder
+void huffman_decoder_free(HuffmanDecoder* decoder);
+
+// Decompress a chunk of data until the output is full or the input runs out
+// *input_used receives the input bytes consumed; undecoded bits stay in the decoder
+// Returns 0 on success, -1 on corrupt input
+int huffman_decompress_chunk(HuffmanDecoder* decoder,
+                            const uint8_t* input_data, size_t input_size, size_t* input_used,
+                            uint8_t* output_data, size_t* output_size);
 
 // Traditional compression and decompression functions
 int compress_file(const char* input_file, const char* output_file);
 int decompress_file(const char* input_file, const char* output_file);
 
+// Buffer-based compression and decompression (self-contained streams)
+// *output_size holds the capacity of output on entry and the bytes produced on return
+// Returns 0 on success, non-zero on failure
+size_t huffman_compress_bound(size_t input_size);
+int compress_huffman_buffer(const uint8_t* input, size_t input_size,
+                            uint8_t* output, size_t* output_size);
+int decompress_huffman_buffer(const uint8_t* input, size_t input_size,
+                              uint8_t* output, size_t* output_size);
+
 // Large file support compression and decompression
 int compress_large_file(const char* input_file, const char* output_file, size_t chunk_size);
 int decompress_large_file(const char* input_file, const char* output_file, size_t chunk_size);
@@ -2,95 +2,145 @@
  * Large File Utilities Implementation
  * Functions for handling files larger than available RAM
  */
+#define _POSIX_C_SOURCE 200809L // For strdup
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 #include "large_file_utils.h"
+#include <openssl/evp.h>
+#include "crc32.h"
 
-// CRC32 table for fast CRC calculation
-static uint32_t crc32_table[256];
-static int crc32_table_initialized = 0;
+// Digest used for a checksum type (NULL for types not computed through EVP)
+static const EVP_MD* checksum_digest(ChecksumType type) {
+    switch (type) {
+        case CHECKSUM_MD5:
+            return EVP_md5();
+        case CHECKSUM_SHA256:
+            return EVP_sha256();
+        default:
+            return NULL;
+    }
+}
 
-// Initialize CRC32 table
-static void init_crc32_table() {
-    if (crc32_table_initialized) return;
-    
-    uint32_t polynomial = 0xEDB88320;
-    for (int i = 0; i < 256; i++) {
-        uint32_t c = i;
-        for (int j = 0; j < 8; j++) {
-            if (c & 1) {
-                c = polynomial ^ (c >> 1);
-            } else {
-                c >>= 1;
-            }
+// Start a streaming checksum
+int checksum_init(ChecksumContext* context, ChecksumType type) {
+    if (!context) return 0;
+    
+    context->type = type;
+    context->crc32 = 0;
+    context->digest = NULL;
+    xxh64_init(&context->xxh64, 0);
+    
+    const EVP_MD* md = checksum_digest(type);
+    if (md) {
+        EVP_MD_CTX* digest = EVP_MD_CTX_new();
+        if (!digest || EVP_DigestInit_ex(digest, md, NULL) != 1) {
+            EVP_MD_CTX_free(digest);
+            return 0;
         }
-        crc32_table[i] = c;
+        context->digest = digest;
     }
-    
-    crc32_table_initialized = 1;
+    return 1;
 }
 
-// Calculate CRC32 checksum
-static uint32_t calculate_crc32(const uint8_t* data, size_t size) {
-    // Initialize the CRC32 table if needed
-    if (!crc32_table_initialized) {
-        init_crc32_table();
-    }
+// Add data to a streaming checksum
+int checksum_update(ChecksumContext* context, const uint8_t* data, size_t size) {
+    if (!context || (!data && size > 0)) return 0;
     
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < size; i++) {
-        uint8_t index = (crc ^ data[i]) & 0xFF;
-        crc = (crc >> 8) ^ crc32_table[index];
+    switch (context->type) {
+        case CHECKSUM_CRC32:
+            context->crc32 = crc32_update(context->crc32, data, size);
+            return 1;
+        
+        case CHECKSUM_XXH64:
+            xxh64_update(&context->xxh64, data, size);
+            return 1;
+        
+        case CHECKSUM_MD5:
+        case CHECKSUM_SHA256:
+            return context->digest && EVP_DigestUpdate((EVP_MD_CTX*)context->digest, data, size) == 1;
+        
+        case CHECKSUM_NONE:
+        default:
+            return 1;
     }
-    
-    return crc ^ 0xFFFFFFFF;
 }
 
-// Calculate MD5 hash (simplified implementation - in a real application, use a library like OpenSSL)
-static void calculate_md5(const uint8_t* data, size_t size, uint8_t* hash) {
-    // Placeholder - in a real implementation, use a proper MD5 library
-    memset(hash, 0, 16);
+// Finish a streaming checksum and release its state
+int checksum_final(ChecksumContext* context, ChecksumData* checksum) {
+    if (!context || !checksum) return 0;
+    
+    int success = 1;
+    memset(checksum, 0, sizeof(*checksum));
+    checksum->type = context->type;
     
-    // Simple hash function for demonstration
-    for (size_t i = 0; i < size; i++) {
-        hash[i % 16] ^= data[i];
+    switch (context->type) {
+        case CHECKSUM_CRC32:
+            checksum->crc32 = context->crc32;
+            break;
+        
+        case CHECKSUM_XXH64:
+            checksum->xxh64 = xxh64_digest(&context->xxh64);
+            break;
+        
+        case CHECKSUM_MD5:
+            success = context->digest && EVP_DigestFinal_ex((EVP_MD_CTX*)context->digest, checksum->md5, NULL) == 1;
+            break;
+        
+        case CHECKSUM_SHA256:
+            success = context->digest && EVP_DigestFinal_ex((EVP_MD_CTX*)context->digest, checksum->sha256, NULL) == 1;
+            break;
+        
+        case CHECKSUM_NONE:
+        default:
+            break;
     }
+    
+    checksum_context_free(context);
+    return success;
 }
 
-// Calculate SHA256 hash (simplified implementation - in a real application, use a library like OpenSSL)
-static void calculate_sha256(const uint8_t* data, size_t size, uint8_t* hash) {
-    // Placeholder - in a real implementation, use a proper SHA256 library
-    memset(hash, 0, 32);
+// Release a streaming checksum without finishing it
+void checksum_context_free(ChecksumContext* context) {
+    if (!context) return;
     
-    // Simple hash function for demonstration
-    for (size_t i = 0; i < size; i++) {
-        hash[i % 32] ^= data[i];
-    }
+    EVP_MD_CTX_free((EVP_MD_CTX*)context->digest);
+    context->digest = NULL;
 }
 
 // Calculate checksums for a buffer
 void calculate_checksum(const uint8_t* data, size_t size, ChecksumData* checksum, ChecksumType type) {
     if (!data || !checksum) return;
     
-    checksum->type = type;
+    ChecksumContext context;
+    if (!checksum_init(&context, type) || !checksum_update(&context, data, size) ||
+        !checksum_final(&context, checksum)) {
+        checksum_context_free(&context);
+        memset(checksum, 0, sizeof(*checksum));
+        checksum->type = type;
+    }
+}
+
+// Compare two checksums of the same type
+int checksum_equal(const ChecksumData* a, const ChecksumData* b) {
+    if (!a || !b || a->type != b->type) return 0;
     
-    switch (type) {
+    switch (a->type) {
         case CHECKSUM_CRC32:
-            checksum->crc32 = calculate_crc32(data, size);
-            break;
-        
+            return a->crc32 == b->crc32;
         case CHECKSUM_MD5:
-            calculate_md5(data, size, checksum->md5);
-            break;
-        
+            return memcmp(a->md5, b->md5, 16) == 0;
         case CHECKSUM_SHA256:
-            calculate_sha256(data, size, checksum->sha256);
-            break;
-        
+            return memcmp(a->sha256, b->sha256, 32) == 0;
+        case CHECKSUM_XXH64:
+            return a->xxh64 == b->xxh64;
         case CHECKSUM_NONE:
         default:
-            break;
+            return 1;
     }
 }
 
@@ -98,28 +148,13 @@ void calculate_checksum(const uint8_t* data, size_t size, ChecksumData* checksum
 int verify_checksum(const uint8_t* data, size_t size, const ChecksumData* checksum) {
     if (!data || !checksum) return 0;
     
-    switch (checksum->type) {
-        case CHECKSUM_CRC32: {
-            uint32_t calculated_crc = calculate_crc32(data, size);
-            return (calculated_crc == checksum->crc32) ? 1 : 0;
-        }
-        
-        case CHECKSUM_MD5: {
-            uint8_t calculated_md5[16];
-            calculate_md5(data, size, calculated_md5);
-            return (memcmp(calculated_md5, checksum->md5, 16) == 0) ? 1 : 0;
-        }
-        
-        case CHECKSUM_SHA256: {
-            uint8_t calculated_sha256[32];
-            calculate_sha256(data, size, calculated_sha256);
-            return (memcmp(calculated_sha256, checksum->sha256, 32) == 0) ? 1 : 0;
-        }
-        
-        case CHECKSUM_NONE:
-        default:
-            return 1;  // No checksum means verification always passes
+    if (checksum->type == CHECKSUM_NONE) {
+        return 1;  // No checksum means verification always passes
     }
+    
+    ChecksumData calculated;
+    calculate_checksum(data, size, &calculated, checksum->type);
+    return checksum_equal(&calculated, checksum);
 }
 
 // Get the size of the checksum data based on type
@@ -131,6 +166,8 @@ size_t get_checksum_size(ChecksumType type) {
             return 16;
         case CHECKSUM_SHA256:
             return 32;
+        case CHECKSUM_XXH64:
+            return sizeof(uint64_t);
         case CHECKSUM_NONE:
         default:
             return 0;
@@ -184,6 +221,10 @@ char* checksum_to_string(const ChecksumData* checksum, char* buffer, size_t buff
             break;
         }
         
+        case CHECKSUM_XXH64:
+            snprintf(buffer, buffer_size, "XXH64: %016llX", (unsigned long long)checksum->xxh64);
+            break;
+        
         case CHECKSUM_NONE:
         default:
             snprintf(buffer, buffer_size, "No checksum");
@@ -275,6 +316,19 @@ LargeFileReader* large_file_reader_init(const char* filename, size_t chunk_size)
     return reader;
 }
 
+// Initialize a large file reader over a memory-mapped window
+LargeFileReader* large_file_reader_init_mapped(const char* filename, size_t chunk_size) {
+    LargeFileReader* reader = large_file_reader_init(filename, chunk_size);
+    
+#ifndef _WIN32
+    if (reader) {
+        reader->mapped = 1;
+    }
+#endif
+    
+    return reader;
+}
+
 // Initialize a large file reader with checksum verification
 LargeFileReader* large_file_reader_init_with_checksum(const char* filename, size_t chunk_size, ChecksumType checksum_type) {
     LargeFileReader* reader = large_file_reader_init(filename, chunk_size);
@@ -302,11 +356,88 @@ void large_file_reader_free(LargeFileReader* reader) {
         free(reader->buffer);
     }
     
+#ifndef _WIN32
+    if (reader->map_window) {
+        munmap(reader->map_window, reader->map_length);
+    }
+#endif
+    
     free(reader);
 }
 
+#ifndef _WIN32
+// Map a window of the file covering size bytes at the cursor
+// Returns 1 on success, 0 if the file cannot be mapped
+static int map_reader_window(LargeFileReader* reader, size_t size) {
+    if (reader->map_window) {
+        munmap(reader->map_window, reader->map_length);
+        reader->map_window = NULL;
+    }
+    
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t offset = reader->current_position & ~(uint64_t)(page_size > 0 ? page_size - 1 : 0);
+    uint64_t length = LARGE_FILE_MAP_WINDOW;
+    if (length < reader->current_position - offset + size) {
+        length = reader->current_position - offset + size;
+    }
+    if (length > reader->file_size - offset) {
+        length = reader->file_size - offset;
+    }
+    if (length > SIZE_MAX) {
+        return 0;
+    }
+    
+    // Private and writable, so callers may scribble on a chunk as they could on the buffer
+    void* window = mmap(NULL, (size_t)length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                        fileno(reader->file), (off_t)offset);
+    if (window == MAP_FAILED) {
+        return 0;
+    }
+    posix_madvise(window, (size_t)length, POSIX_MADV_SEQUENTIAL);
+    
+    reader->map_window = (uint8_t*)window;
+    reader->map_offset = offset;
+    reader->map_length = (size_t)length;
+    return 1;
+}
+
+// Point at the next size bytes in the mapped window, sliding it forward as needed
+// and asking the kernel to start reading the chunks after it
+static uint8_t* map_reader_chunk(LargeFileReader* reader, size_t size) {
+    uint64_t start = reader->current_position;
+    uint64_t end = start + size;
+    
+    if (!reader->map_window || start < reader->map_offset ||
+        end > reader->map_offset + reader->map_length) {
+        if (!map_reader_window(reader, size)) {
+            return NULL;
+        }
+    }
+    
+    uint64_t window_end = reader->map_offset + reader->map_length;
+    uint64_t ahead_end = end + (uint64_t)reader->chunk_size * LARGE_FILE_MAP_READAHEAD_CHUNKS;
+    if (ahead_end > window_end) {
+        ahead_end = window_end;
+    }
+    if (ahead_end > end) {
+        // madvise ranges must start on a page boundary
+        long page_size = sysconf(_SC_PAGESIZE);
+        uint64_t ahead_start = end & ~(uint64_t)(page_size > 0 ? page_size - 1 : 0);
+        posix_madvise(reader->map_window + (ahead_start - reader->map_offset),
+                      (size_t)(ahead_end - ahead_start), POSIX_MADV_WILLNEED);
+    }
+    
+    return reader->map_window + (start - reader->map_offset);
+}
+#endif
+
 // Read the next chunk from a file
 uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_read) {
+    return large_file_reader_next_chunk_max(reader, reader ? reader->chunk_size : 0, bytes_read);
+}
+
+// Read the next chunk, stopping after at most max_size bytes
+uint8_t* large_file_reader_next_chunk_max(LargeFileReader* reader, size_t max_size, size_t* bytes_read) {
     if (!reader || !reader->file || !bytes_read || reader->eof_reached) {
         if (bytes_read) *bytes_read = 0;
         return NULL;
@@ -327,7 +458,7 @@ uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_rea
         reader->current_position += sizeof(uint32_t);
         
         // Read checksum data based on type
-        if (stored_type > CHECKSUM_NONE && stored_type <= CHECKSUM_SHA256) {
+        if (stored_type > CHECKSUM_NONE && stored_type <= CHECKSUM_XXH64) {
             checksum.type = (ChecksumType)stored_type;
             
             switch (checksum.type) {
@@ -358,6 +489,15 @@ uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_rea
                     reader->current_position += 32;
                     break;
                 
+                case CHECKSUM_XXH64:
+                    if (fread(&checksum.xxh64, sizeof(uint64_t), 1, reader->file) != 1) {
+                        fprintf(stderr, "Error reading XXH64 checksum\n");
+                        *bytes_read = 0;
+                        return NULL;
+                    }
+                    reader->current_position += sizeof(uint64_t);
+                    break;
+                
                 default:
                     break;
             }
@@ -414,7 +554,8 @@ uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_rea
         uint64_t remaining = reader->file_size - reader->current_position;
         
         // Determine how many bytes to read
-        size_t to_read = (remaining < reader->chunk_size) ? (size_t)remaining : reader->chunk_size;
+        size_t limit = (max_size < reader->chunk_size) ? max_size : reader->chunk_size;
+        size_t to_read = (remaining < limit) ? (size_t)remaining : limit;
         
         // If there's nothing left to read, return EOF
         if (to_read == 0) {
@@ -423,6 +564,28 @@ uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_rea
             return NULL;
         }
         
+#ifndef _WIN32
+        // Mapped mode: hand out the chunk in place
+        if (reader->mapped) {
+            uint8_t* chunk = map_reader_chunk(reader, to_read);
+            if (chunk) {
+                reader->current_position += to_read;
+                if (reader->current_position >= reader->file_size) {
+                    reader->eof_reached = 1;
+                }
+                *bytes_read = to_read;
+                return chunk;
+            }
+            
+            // Mapping failed: continue with ordinary reads from the cursor
+            reader->mapped = 0;
+            if (fseeko(reader->file, (off_t)reader->current_position, SEEK_SET) != 0) {
+                *bytes_read = 0;
+                return NULL;
+            }
+        }
+#endif
+        
         // Read data into buffer
         size_t actual_read = fread(reader->buffer, 1, to_read, reader->file);
         
@@ -582,6 +745,12 @@ int large_file_writer_write(LargeFileWriter* writer, const uint8_t* data, size_t
                 }
                 break;
             
+            case CHECKSUM_XXH64:
+                if (fwrite(&checksum.xxh64, sizeof(uint64_t), 1, writer->file) != 1) {
+                    return -1;
+                }
+                break;
+            
             default:
                 break;
         }
@@ -677,6 +846,12 @@ int large_file_writer_flush(LargeFileWriter* writer) {
                     }
                     break;
                 
+                case CHECKSUM_XXH64:
+                    if (fwrite(&checksum.xxh64, sizeof(uint64_t), 1, writer->file) != 1) {
+                        return -1;
+                    }
+                    break;
+                
                 default:
                     break;
             }
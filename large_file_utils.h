@@ -8,16 +8,23 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "xxh64.h"
 
 // Default chunk size (1MB)
 #define DEFAULT_CHUNK_SIZE (1024 * 1024)
 
+// Size of the sliding window a mapped reader keeps mapped (64MB, grown to fit a chunk)
+#define LARGE_FILE_MAP_WINDOW (64 * 1024 * 1024)
+// Chunks past the cursor a mapped reader asks the kernel to read ahead
+#define LARGE_FILE_MAP_READAHEAD_CHUNKS 2
+
 // Checksum type enumeration
 typedef enum {
     CHECKSUM_NONE = 0,   // No checksum
     CHECKSUM_CRC32 = 1,  // CRC32 checksum
     CHECKSUM_MD5 = 2,    // MD5 hash
-    CHECKSUM_SHA256 = 3  // SHA256 hash
+    CHECKSUM_SHA256 = 3, // SHA256 hash
+    CHECKSUM_XXH64 = 4   // XXH64 hash (fast, non-cryptographic)
 } ChecksumType;
 
 // Checksum data structure
@@ -26,8 +33,17 @@ typedef struct {
     uint32_t crc32;       // CRC32 value (if used)
     uint8_t md5[16];      // MD5 hash (if used)
     uint8_t sha256[32];   // SHA256 hash (if used)
+    uint64_t xxh64;       // XXH64 value (if used)
 } ChecksumData;
 
+// Streaming checksum state, fed one buffer at a time
+typedef struct {
+    ChecksumType type;    // Type of checksum
+    uint32_t crc32;       // Running CRC32 (if used)
+    Xxh64State xxh64;     // Running XXH64 (if used)
+    void* digest;         // OpenSSL EVP_MD_CTX for MD5 and SHA256 (NULL otherwise)
+} ChecksumContext;
+
 // Structure for large file processing
 typedef struct {
     FILE* file;
@@ -38,6 +54,10 @@ typedef struct {
     uint8_t* buffer;
     int eof_reached;
     ChecksumType checksum_type; // Type of checksum to use/verify
+    int mapped;                 // Whether chunks point into a mapped window instead of buffer
+    uint8_t* map_window;        // Current mapped window (NULL if none)
+    uint64_t map_offset;        // File offset of the window
+    size_t map_length;          // Length of the window
 } LargeFileReader;
 
 // Structure for output file
@@ -54,6 +74,11 @@ typedef struct {
 // Initialize a large file reader
 LargeFileReader* large_file_reader_init(const char* filename, size_t chunk_size);
 
+// Initialize a large file reader that returns chunks straight from a sliding memory-mapped
+// window instead of copying them into its buffer (falls back to reads if mapping fails)
+// Chunks stay valid until the next call; checksum framing is not supported in this mode
+LargeFileReader* large_file_reader_init_mapped(const char* filename, size_t chunk_size);
+
 // Initialize a large file reader with checksum verification
 LargeFileReader* large_file_reader_init_with_checksum(const char* filename, size_t chunk_size, ChecksumType checksum_type);
 
@@ -65,6 +90,9 @@ void large_file_reader_free(LargeFileReader* reader);
 // Sets bytes_read to the number of bytes read
 uint8_t* large_file_reader_next_chunk(LargeFileReader* reader, size_t* bytes_read);
 
+// Read the next chunk, stopping after at most max_size bytes (or chunk_size, if smaller)
+uint8_t* large_file_reader_next_chunk_max(LargeFileReader* reader, size_t max_size, size_t* bytes_read);
+
 // Reset reader to the beginning of the file
 int large_file_reader_reset(LargeFileReader* reader);
 
@@ -83,9 +111,24 @@ int large_file_writer_write(LargeFileWriter* writer, const uint8_t* data, size_t
 // Flush any remaining data in the buffer to the file
 int large_file_writer_flush(LargeFileWriter* writer);
 
+// Start a streaming checksum. Returns 1 on success, 0 on failure
+int checksum_init(ChecksumContext* context, ChecksumType type);
+
+// Add data to a streaming checksum. Returns 1 on success, 0 on failure
+int checksum_update(ChecksumContext* context, const uint8_t* data, size_t size);
+
+// Finish a streaming checksum into checksum and release its state. Returns 1 on success, 0 on failure
+int checksum_final(ChecksumContext* context, ChecksumData* checksum);
+
+// Release a streaming checksum without finishing it (safe to call after checksum_final)
+void checksum_context_free(ChecksumContext* context);
+
 // Calculate checksums for a buffer
 void calculate_checksum(const uint8_t* data, size_t size, ChecksumData* checksum, ChecksumType type);
 
+// Compare two checksums. Returns 1 if they have the same type and value
+int checksum_equal(const ChecksumData* a, const ChecksumData* b);
+
 // Verify data against a checksum
 int verify_checksum(const uint8_t* data, size_t size, const ChecksumData* checksum);
 
@@ -14,6 +14,7 @@
 size_t WINDOW_SIZE = DEFAULT_WINDOW_SIZE;
 size_t LOOKAHEAD_SIZE = DEFAULT_LOOKAHEAD_SIZE;
 size_t MIN_MATCH = DEFAULT_MIN_MATCH;
+size_t MAX_CHAIN_DEPTH = DEFAULT_CHAIN_DEPTH;
 
 // Set LZ77 parameters based on optimization goal
 void set_lz77_optimization(int optimization_goal) {
@@ -23,75 +24,154 @@ void set_lz77_optimization(int optimization_goal) {
             WINDOW_SIZE = SPEED_WINDOW_SIZE;
             LOOKAHEAD_SIZE = SPEED_LOOKAHEAD_SIZE;
             MIN_MATCH = SPEED_MIN_MATCH;
+            MAX_CHAIN_DEPTH = SPEED_CHAIN_DEPTH;
             break;
         case OPT_SIZE:
             printf("Optimizing LZ77 for size\n");
             WINDOW_SIZE = SIZE_WINDOW_SIZE;
             LOOKAHEAD_SIZE = SIZE_LOOKAHEAD_SIZE;
             MIN_MATCH = SIZE_MIN_MATCH;
+            MAX_CHAIN_DEPTH = SIZE_CHAIN_DEPTH;
             break;
         default:
             // Use defaults
             WINDOW_SIZE = DEFAULT_WINDOW_SIZE;
             LOOKAHEAD_SIZE = DEFAULT_LOOKAHEAD_SIZE;
             MIN_MATCH = DEFAULT_MIN_MATCH;
+            MAX_CHAIN_DEPTH = DEFAULT_CHAIN_DEPTH;
             break;
     }
 }
 
-// Helper function to find the longest match in the window
-static void find_longest_match(const uint8_t *data, size_t data_size, size_t current_pos,
-                               uint16_t *match_offset, uint8_t *match_length) {
-    size_t window_start = (current_pos <= WINDOW_SIZE) ? 0 : current_pos - WINDOW_SIZE;
-    size_t lookahead_end = current_pos + LOOKAHEAD_SIZE;
-    if (lookahead_end > data_size) {
-        lookahead_end = data_size;
+// Marker for an empty hash bucket or the end of a chain
+#define CHAIN_NIL ((size_t)-1)
+
+// Hash-chain match finder state
+typedef struct {
+    size_t *head;        // Most recent position for each hash bucket
+    size_t *prev;        // Previous position with the same hash (ring indexed by position)
+    size_t prev_mask;    // Ring size - 1 (ring size is a power of two >= WINDOW_SIZE)
+    size_t key_length;   // Number of prefix bytes hashed
+} MatchFinder;
+
+// Initialize the match finder for the current window size
+static int match_finder_init(MatchFinder *finder) {
+    size_t ring_size = 1;
+    while (ring_size < WINDOW_SIZE) {
+        ring_size <<= 1;
+    }
+    
+    finder->head = (size_t *)malloc(((size_t)1 << LZ77_HASH_BITS) * sizeof(size_t));
+    finder->prev = (size_t *)malloc(ring_size * sizeof(size_t));
+    if (!finder->head || !finder->prev) {
+        free(finder->head);
+        free(finder->prev);
+        return 1;
     }
     
+    // All bits set is CHAIN_NIL
+    memset(finder->head, 0xFF, ((size_t)1 << LZ77_HASH_BITS) * sizeof(size_t));
+    finder->prev_mask = ring_size - 1;
+    finder->key_length = (MIN_MATCH < 4) ? MIN_MATCH : 4;
+    if (finder->key_length == 0) {
+        finder->key_length = 1;
+    }
+    return 0;
+}
+
+// Free the match finder tables
+static void match_finder_free(MatchFinder *finder) {
+    free(finder->head);
+    free(finder->prev);
+}
+
+// Hash the key_length-byte prefix starting at p
+static inline uint32_t hash_prefix(const MatchFinder *finder, const uint8_t *p) {
+    uint32_t key = 0;
+    for (size_t i = 0; i < finder->key_length; i++) {
+        key = (key << 8) | p[i];
+    }
+    return (key * 2654435761u) >> (32 - LZ77_HASH_BITS);
+}
+
+// Add a position to the head of its hash chain
+static inline void match_finder_insert(MatchFinder *finder, const uint8_t *data, size_t data_size, size_t pos) {
+    if (pos + finder->key_length > data_size) {
+        return;
+    }
+    uint32_t h = hash_prefix(finder, data + pos);
+    finder->prev[pos & finder->prev_mask] = finder->head[h];
+    finder->head[h] = pos;
+}
+
+// Helper function to find the longest match in the window by walking the hash chain
+static void find_longest_match(const MatchFinder *finder, const uint8_t *data, size_t data_size,
+                               size_t current_pos, uint16_t *match_offset, uint8_t *match_length) {
     *match_offset = 0;
     *match_length = 0;
     
     // If the remaining data is too small, don't try to find a match
-    if (current_pos + MIN_MATCH > data_size) {
+    if (current_pos + MIN_MATCH > data_size || current_pos + finder->key_length > data_size) {
         return;
     }
     
-    // Optimization: For speed, we can implement a hash table for faster matching
-    // But for now, we'll optimize the search loop
+    size_t max_length = data_size - current_pos;
+    if (max_length > LOOKAHEAD_SIZE) {
+        max_length = LOOKAHEAD_SIZE;
+    }
+    if (max_length > UINT8_MAX) {
+        max_length = UINT8_MAX;
+    }
+    
+    const uint8_t *current = data + current_pos;
+    size_t best_length = 0;
+    size_t best_distance = 0;
+    size_t depth = MAX_CHAIN_DEPTH;
+    size_t candidate = finder->head[hash_prefix(finder, current)];
     
-    // For each position in the window, try to find a match
-    for (size_t i = window_start; i < current_pos; i++) {
-        // Quick check: if the first byte doesn't match, continue
-        if (data[i] != data[current_pos]) {
-            continue;
+    // Chains are ordered newest first, so stop once we fall outside the window
+    while (candidate != CHAIN_NIL && candidate < current_pos && depth-- > 0) {
+        size_t distance = current_pos - candidate;
+        if (distance > WINDOW_SIZE) {
+            break;
         }
         
-        size_t j;
-        size_t current_match_length = 0;
+        const uint8_t *match = data + candidate;
         
-        // Compare bytes in the window with bytes in the lookahead buffer
-        for (j = 0; j < lookahead_end - current_pos; j++) {
-            if (data[i + j] != data[current_pos + j]) {
-                break;
+        // Quick check: a longer match must also agree on the byte past the current best
+        if (match[best_length] == current[best_length]) {
+            size_t length = 0;
+            while (length < max_length && match[length] == current[length]) {
+                length++;
             }
-            current_match_length++;
-        }
-        
-        // If this match is longer than the previous best match
-        if (current_match_length >= MIN_MATCH && current_match_length > *match_length) {
-            *match_offset = current_pos - i;
             
-            // Cap match length to maximum uint8_t value
-            if (current_match_length >= UINT8_MAX) {
-                *match_length = UINT8_MAX;
-                break;
-            } else {
-                *match_length = (uint8_t)current_match_length;
+            if (length > best_length) {
+                best_length = length;
+                best_distance = distance;
+                if (length == max_length) {
+                    break;
+                }
             }
         }
+        
+        size_t next = finder->prev[candidate & finder->prev_mask];
+        if (next >= candidate) {
+            break; // Ring slot was reused by a newer position
+        }
+        candidate = next;
+    }
+    
+    if (best_length >= MIN_MATCH) {
+        *match_offset = (uint16_t)best_distance;
+        *match_length = (uint8_t)best_length;
     }
 }
 
+// Worst-case compressed size: every byte emitted as a two-byte literal token
+size_t lz77_compress_bound(size_t input_size) {
+    return input_size * 2;
+}
+
 // Compress data using LZ77 algorithm
 int compress_lz77_buffer(const uint8_t *input, size_t input_size, 
                         uint8_t *output, size_t *output_size) {
@@ -99,7 +179,18 @@ int compress_lz77_buffer(const uint8_t *input, size_t input_size,
     size_t out_pos = 0;
     
     // Check for invalid parameters
-    if (!input || !output || !output_size || input_size == 0) {
+    if (!input || !output || !output_size) {
+        return 1;
+    }
+    
+    if (input_size == 0) {
+        *output_size = 0;
+        return 0;
+    }
+    
+    MatchFinder finder;
+    if (match_finder_init(&finder) != 0) {
+        printf("Error: Memory allocation failed for LZ77 match finder\n");
         return 1;
     }
     
@@ -109,10 +200,11 @@ int compress_lz77_buffer(const uint8_t *input, size_t input_size,
         uint8_t match_length = 0;
         
         // Find the longest match
-        find_longest_match(input, input_size, in_pos, &match_offset, &match_length);
+        find_longest_match(&finder, input, input_size, in_pos, &match_offset, &match_length);
         
-        // Write the token to the output
-        if (out_pos + 4 > *output_size) {
+        // Write the token to the output (4 bytes for a match, 2 for a literal)
+        if (out_pos + ((match_length >= MIN_MATCH) ? 4 : 2) > *output_size) {
+            match_finder_free(&finder);
             return 1; // Output buffer too small
         }
         
@@ -125,14 +217,18 @@ int compress_lz77_buffer(const uint8_t *input, size_t input_size,
             output[out_pos++] = match_offset & 0xFF;        // Low byte of offset
             output[out_pos++] = match_length;
             
-            // Move input position
-            in_pos += match_length;
+            // Index every position covered by the match, then move past it
+            for (size_t end = in_pos + match_length; in_pos < end; in_pos++) {
+                match_finder_insert(&finder, input, input_size, in_pos);
+            }
         } else {
             // Write a literal
+            match_finder_insert(&finder, input, input_size, in_pos);
             output[out_pos++] = input[in_pos++];
         }
     }
     
+    match_finder_free(&finder);
     *output_size = out_pos;
     return 0;
 }
@@ -144,7 +240,7 @@ int decompress_lz77_buffer(const uint8_t *input, size_t input_size,
     size_t out_pos = 0;
     
     // Check for invalid parameters
-    if (!input || !output || !output_size || input_size == 0) {
+    if (!input || !output || !output_size) {
         return 1;
     }
     
@@ -237,7 +333,7 @@ int compress_lz77(const char *input_file, const char *output_file) {
     
     // Allocate buffers
     input_buffer = (uint8_t *)malloc(input_size);
-    output_buffer = (uint8_t *)malloc(input_size * 2); // Worst case: expansion
+    output_buffer = (uint8_t *)malloc(lz77_compress_bound(input_size));
     
     if (!input_buffer || !output_buffer) {
         printf("Error: Memory allocation failed\n");
@@ -269,7 +365,7 @@ int compress_lz77(const char *input_file, const char *output_file) {
     fclose(infile);
     
     // Compress the data
-    output_size = input_size * 2; // Start with worst-case size
+    output_size = lz77_compress_bound(input_size);
     if (compress_lz77_buffer(input_buffer, input_size, output_buffer, &output_size) != 0) {
         printf("Error: Compression failed\n");
         free(input_buffer);
@@ -23,10 +23,17 @@
 #define SIZE_LOOKAHEAD_SIZE   32    // Larger lookahead buffer
 #define SIZE_MIN_MATCH        2     // Smaller minimum match for better compression
 
+// Hash-chain match finder parameters
+#define LZ77_HASH_BITS        15    // 32K hash buckets keyed on MIN_MATCH-byte prefixes
+#define DEFAULT_CHAIN_DEPTH   32    // Candidates examined per position
+#define SPEED_CHAIN_DEPTH     8     // Short chains for faster search
+#define SIZE_CHAIN_DEPTH      256   // Long chains for better matches
+
 // Current parameters (will be set at runtime)
 extern size_t WINDOW_SIZE;
 extern size_t LOOKAHEAD_SIZE;
 extern size_t MIN_MATCH;
+extern size_t MAX_CHAIN_DEPTH;
 
 // Token structure to represent LZ77 output
 typedef struct {
@@ -40,6 +47,7 @@ int compress_lz77(const char *input_file, const char *output_file);
 int decompress_lz77(const char *input_file, const char *output_file);
 
 // Buffer operations
+size_t lz77_compress_bound(size_t input_size);
 int compress_lz77_buffer(const uint8_t *input, size_t input_size, 
                         uint8_t *output, size_t *output_size);
 int decompress_lz77_buffer(const uint8_t *input, size_t input_size,
@@ -6,9 +6,11 @@
 #include <string.h>
 #include "lz77.h"
 #include "parallel.h"
+#include "filecompressor.h" // For get_optimization_goal()
 
 // Function to compress a file using parallel LZ77 algorithm
 int compress_lz77_parallel(const char *input_file, const char *output_file) {
+    set_lz77_optimization(get_optimization_goal());
     return compress_file_parallel(input_file, output_file, 
         get_algorithm_by_type(LZ77), get_thread_count());
 }
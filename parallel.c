@@ -7,6 +7,8 @@
 #include <string.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -17,22 +19,293 @@
 #include "parallel.h"
 #include "huffman.h"
 #include "rle.h"
+#include "crc32.h"
 
 // Chunk information structure
 typedef struct {
-    uint8_t *data;      // Chunk data
-    size_t size;        // Size of the chunk
-    size_t original_offset; // Original offset in the file
-    char *output_path;  // Temporary output path for this chunk
+    uint8_t *data;          // Chunk input data
+    size_t size;            // Size of the chunk input
+    size_t data_capacity;   // Allocated size of data
+    uint8_t *output;        // Per-chunk output buffer
+    size_t output_size;     // Capacity of output on entry, bytes produced on return
+    size_t output_capacity; // Allocated size of output
     CompressionAlgorithm *algorithm; // Compression algorithm to use
-    int thread_id;      // Thread ID
+    int thread_id;          // Chunk index used in log messages
+    int status;             // 0 on success
+    uint32_t crc;           // CRC32 of the chunk's uncompressed data
+    ParallelTask task;      // Pool task processing this chunk
 } ChunkInfo;
 
+// Double-ended task queue; the newest task is at the tail
+typedef struct {
+    pthread_mutex_t lock;
+    ParallelTask *head;
+    ParallelTask *tail;
+} TaskDeque;
+
+// Process-wide work-stealing pool
+// Each worker pops its own deque at the tail (newest first, for locality of nested
+// tasks), then takes from the shared queue, then steals the oldest task of another worker
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;    // Signalled when a task is queued or on shutdown
+    pthread_cond_t work_done;     // Broadcast when any task finishes
+    TaskDeque deques[MAX_THREADS]; // Per-worker deques
+    TaskDeque shared;             // Tasks submitted from outside the pool, oldest first
+    atomic_int pending;           // Tasks queued but not yet taken
+    pthread_t workers[MAX_THREADS];
+    atomic_int worker_count;      // Workers currently running
+    int target_count;             // Workers to run once the pool is used
+    int shutting_down;
+    int exit_handler_registered;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_ready = PTHREAD_COND_INITIALIZER,
+    .work_done = PTHREAD_COND_INITIALIZER,
+    .shared = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+// Index of the pool worker running on this thread, -1 for other threads
+static _Thread_local int current_worker = -1;
+
+// Append a task at the tail of a deque
+static void deque_push(TaskDeque *deque, ParallelTask *task) {
+    pthread_mutex_lock(&deque->lock);
+    task->next = NULL;
+    task->prev = deque->tail;
+    if (deque->tail) {
+        deque->tail->next = task;
+    } else {
+        deque->head = task;
+    }
+    deque->tail = task;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// Remove the newest (from_tail) or oldest task of a deque
+static ParallelTask *deque_pop(TaskDeque *deque, int from_tail) {
+    pthread_mutex_lock(&deque->lock);
+    ParallelTask *task = from_tail ? deque->tail : deque->head;
+    if (task) {
+        if (task->prev) {
+            task->prev->next = task->next;
+        } else {
+            deque->head = task->next;
+        }
+        if (task->next) {
+            task->next->prev = task->prev;
+        } else {
+            deque->tail = task->prev;
+        }
+        task->prev = task->next = NULL;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+// Find work for a thread: own deque, then the shared queue, then steal
+static ParallelTask *pool_take_task(int self) {
+    ParallelTask *task = NULL;
+
+    if (self >= 0) {
+        task = deque_pop(&pool.deques[self], 1);
+    }
+    if (!task) {
+        task = deque_pop(&pool.shared, 0);
+    }
+
+    int count = atomic_load(&pool.worker_count);
+    for (int i = 1; !task && i <= count; i++) {
+        int victim = (self + i) % count;
+        if (victim < 0) {
+            victim += count;
+        }
+        if (victim != self) {
+            task = deque_pop(&pool.deques[victim], 0);
+        }
+    }
+
+    if (task) {
+        atomic_fetch_sub(&pool.pending, 1);
+    }
+    return task;
+}
+
+// Run a task and mark it done
+static void pool_run_task(ParallelTask *task) {
+    task->run(task->arg);
+
+    pthread_mutex_lock(&pool.lock);
+    task->done = 1;
+    pthread_cond_broadcast(&pool.work_done);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Worker loop: run tasks until shutdown drains the queues
+static void *pool_worker(void *arg) {
+    current_worker = (int)(intptr_t)arg;
+
+    for (;;) {
+        ParallelTask *task = pool_take_task(current_worker);
+        if (task) {
+            pool_run_task(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        while (atomic_load(&pool.pending) <= 0 && !pool.shutting_down) {
+            pthread_cond_wait(&pool.work_ready, &pool.lock);
+        }
+        int stop = pool.shutting_down && atomic_load(&pool.pending) <= 0;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (stop) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Start workers up to the target count (pool lock held)
+static void pool_start_workers_locked(void) {
+    if (pool.target_count <= 0) {
+        int count = get_optimal_threads();
+        pool.target_count = (count <= 0) ? 1 : (count > MAX_THREADS) ? MAX_THREADS : count;
+    }
+
+    int count = atomic_load(&pool.worker_count);
+    while (count < pool.target_count) {
+        TaskDeque *deque = &pool.deques[count];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->head = deque->tail = NULL;
+
+        if (pthread_create(&pool.workers[count], NULL, pool_worker, (void*)(intptr_t)count) != 0) {
+            perror("Thread creation failed");
+            pthread_mutex_destroy(&deque->lock);
+            break;
+        }
+        count++;
+        atomic_store(&pool.worker_count, count);
+    }
+
+    if (count > 0 && !pool.exit_handler_registered) {
+        atexit(shutdown_parallel_compression);
+        pool.exit_handler_registered = 1;
+    }
+}
+
 // Initialize parallel compression subsystem
+// Sets the pool size; workers start on first use, and a running pool only grows
 void init_parallel_compression(int num_threads) {
-    (void)num_threads; // Mark as unused for now
-    // Set up any global resources needed
-    // Currently nothing needed beyond per-thread setup
+    if (num_threads <= 0) {
+        num_threads = get_optimal_threads();
+    }
+    if (num_threads <= 0) {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.target_count = num_threads;
+    if (atomic_load(&pool.worker_count) > 0) {
+        pool_start_workers_locked();
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Finish queued tasks and stop all workers
+void shutdown_parallel_compression(void) {
+    pthread_mutex_lock(&pool.lock);
+    int count = atomic_load(&pool.worker_count);
+    pool.shutting_down = 1;
+    pthread_cond_broadcast(&pool.work_ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < count; i++) {
+        pthread_join(pool.workers[i], NULL);
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    atomic_store(&pool.worker_count, 0);
+    pool.shutting_down = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Number of worker threads the pool runs
+int parallel_pool_size(void) {
+    pthread_mutex_lock(&pool.lock);
+    int count = atomic_load(&pool.worker_count);
+    if (count == 0) {
+        count = pool.target_count;
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return count > 0 ? count : 1;
+}
+
+// Queue a task for the pool
+int parallel_submit(ParallelTask *task, void (*run)(void *arg), void *arg) {
+    if (!task || !run) {
+        return 1;
+    }
+
+    task->run = run;
+    task->arg = arg;
+    task->done = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    if (atomic_load(&pool.worker_count) == 0 && !pool.shutting_down) {
+        pool_start_workers_locked();
+    }
+    int have_workers = atomic_load(&pool.worker_count) > 0;
+    pthread_mutex_unlock(&pool.lock);
+
+    if (!have_workers) {
+        // No workers available: run on the calling thread
+        pool_run_task(task);
+        return 0;
+    }
+
+    deque_push(current_worker >= 0 ? &pool.deques[current_worker] : &pool.shared, task);
+    atomic_fetch_add(&pool.pending, 1);
+
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_signal(&pool.work_ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    return 0;
+}
+
+// Wait for a task; the caller runs other tasks meanwhile so nested waits cannot deadlock
+void parallel_wait(ParallelTask *task) {
+    if (!task) {
+        return;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        int done = task->done;
+        pthread_mutex_unlock(&pool.lock);
+        if (done) {
+            return;
+        }
+
+        ParallelTask *other = pool_take_task(current_worker);
+        if (other) {
+            pool_run_task(other);
+            continue;
+        }
+
+        // Nothing to help with: sleep until some task finishes
+        pthread_mutex_lock(&pool.lock);
+        if (!task->done) {
+            pthread_cond_wait(&pool.work_done, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
 }
 
 // Get optimal number of threads based on system capabilities
@@ -47,105 +320,104 @@ int get_optimal_threads() {
 #endif
 }
 
-// Helper function to create temporary filenames for chunks
-char* create_temp_filename(const char* base_path, int thread_id) {
-    char* temp_path = malloc(strlen(base_path) + 32);
-    if (!temp_path) {
-        perror("Memory allocation error");
-        return NULL;
-    }
-    sprintf(temp_path, "%s.chunk%d.tmp", base_path, thread_id);
-    return temp_path;
-}
-
-// Thread function for compressing chunks
-void* compress_chunk_thread(void *arg) {
+// Pool task for compressing a chunk
+static void compress_chunk_task(void *arg) {
     ChunkInfo *chunk = (ChunkInfo*)arg;
-    
-    // Create temporary file for this chunk
-    FILE *temp_file = fopen(chunk->output_path, "wb");
-    if (!temp_file) {
-        perror("Error creating temporary file");
-        return NULL;
-    }
-    
-    // Write the chunk header - original size and offset
-    fwrite(&chunk->original_offset, sizeof(size_t), 1, temp_file);
-    fwrite(&chunk->size, sizeof(size_t), 1, temp_file);
-    
-    // Create temporary input file for the chunk
-    char temp_input_path[256];
-    sprintf(temp_input_path, "chunk_input_%d.tmp", chunk->thread_id);
-    FILE *temp_input = fopen(temp_input_path, "wb");
-    if (!temp_input) {
-        perror("Error creating temporary input file");
-        fclose(temp_file);
-        return NULL;
-    }
-    
-    // Write chunk data to temporary input file
-    fwrite(chunk->data, 1, chunk->size, temp_input);
-    fclose(temp_input);
-    
-    // Close output file first so it can be reopened by compression algorithm
-    fclose(temp_file);
-    
-    // Compress the chunk using the specified algorithm
+
     printf("Thread %d: Compressing chunk of size %zu\n", chunk->thread_id, chunk->size);
-    chunk->algorithm->compress(temp_input_path, chunk->output_path);
-    
-    // Clean up temporary input file
-    remove(temp_input_path);
-    
-    return NULL;
+    chunk->status = chunk->algorithm->buffer_compress(chunk->data, chunk->size,
+                                                      chunk->output, &chunk->output_size);
+    if (chunk->status != 0) {
+        fprintf(stderr, "Thread %d: Compression failed\n", chunk->thread_id);
+        return;
+    }
+    chunk->crc = crc32_compute(chunk->data, chunk->size);
 }
 
-// Thread function for decompressing chunks
-void* decompress_chunk_thread(void *arg) {
+// Pool task for decompressing a chunk
+static void decompress_chunk_task(void *arg) {
     ChunkInfo *chunk = (ChunkInfo*)arg;
-    
-    // Create temporary input file for the chunk
-    char temp_input_path[256];
-    sprintf(temp_input_path, "chunk_input_%d.tmp", chunk->thread_id);
-    FILE *temp_input = fopen(temp_input_path, "wb");
-    if (!temp_input) {
-        perror("Error creating temporary input file");
-        return NULL;
-    }
-    
-    // Write chunk data to temporary input file
-    fwrite(chunk->data, 1, chunk->size, temp_input);
-    fclose(temp_input);
-    
-    // Decompress the chunk using the specified algorithm
+    size_t expected_size = chunk->output_size;
+
     printf("Thread %d: Decompressing chunk\n", chunk->thread_id);
-    chunk->algorithm->decompress(temp_input_path, chunk->output_path);
-    
-    // Clean up temporary input file
-    remove(temp_input_path);
-    
-    return NULL;
+    chunk->status = chunk->algorithm->buffer_decompress(chunk->data, chunk->size,
+                                                        chunk->output, &chunk->output_size);
+    if (chunk->status == 0 && chunk->output_size != expected_size) {
+        fprintf(stderr, "Thread %d: Decompressed %zu bytes, expected %zu\n",
+                chunk->thread_id, chunk->output_size, expected_size);
+        chunk->status = 1;
+    }
+    if (chunk->status != 0) {
+        fprintf(stderr, "Thread %d: Decompression failed\n", chunk->thread_id);
+        return;
+    }
+    chunk->crc = crc32_compute(chunk->output, chunk->output_size);
+}
+
+// Write one compressed chunk record: original size, compressed size, payload
+static int write_chunk_record(FILE *out, uint64_t original_size, const uint8_t *data, uint64_t size) {
+    if (fwrite(&original_size, sizeof(uint64_t), 1, out) != 1 ||
+        fwrite(&size, sizeof(uint64_t), 1, out) != 1 ||
+        fwrite(data, 1, size, out) != size) {
+        return 1;
+    }
+    return 0;
+}
+
+// Grow a ring slot buffer to hold at least size bytes
+static int ensure_capacity(uint8_t **buffer, size_t *capacity, size_t size) {
+    if (size <= *capacity && *buffer) {
+        return 0;
+    }
+
+    uint8_t *grown = (uint8_t*)realloc(*buffer, size ? size : 1);
+    if (!grown) {
+        return 1;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return 0;
+}
+
+// Free a ring of chunk slots
+static void free_chunk_ring(ChunkInfo *slots, int slot_count) {
+    if (!slots) {
+        return;
+    }
+    for (int i = 0; i < slot_count; i++) {
+        free(slots[i].data);
+        free(slots[i].output);
+    }
+    free(slots);
 }
 
 // Compress a file in parallel using multiple threads
+// The input streams through a fixed ring of chunk slots: the calling thread reads chunks
+// into free slots, pool workers compress them, and the calling thread writes them in order.
+// Peak memory is slot_count * (chunk + compressed chunk) whatever the file size.
 int compress_file_parallel(const char *input_file, const char *output_file, CompressionAlgorithm *algorithm, int num_threads) {
+    if (!algorithm || !algorithm->buffer_compress || !algorithm->buffer_bound) {
+        printf("Error: Algorithm does not support in-memory parallel compression\n");
+        return 1;
+    }
+
     FILE *in = fopen(input_file, "rb");
     if (!in) {
         printf("Error opening input file: %s\n", input_file);
         return 1;
     }
-    
+
     // Get file size
     fseek(in, 0, SEEK_END);
     long file_size = ftell(in);
     fseek(in, 0, SEEK_SET);
-    
+
     if (file_size == 0) {
         printf("Empty input file\n");
         fclose(in);
         return 1;
     }
-    
+
     // Determine optimal number of threads if not specified
     if (num_threads <= 0) {
         num_threads = get_optimal_threads();
@@ -153,183 +425,154 @@ int compress_file_parallel(const char *input_file, const char *output_file, Comp
     if (num_threads > MAX_THREADS) {
         num_threads = MAX_THREADS;
     }
-    
-    // Adjust number of threads for small files
-    if (file_size < num_threads * 1024) {  // Less than 1KB per thread
-        num_threads = 1;
-    }
-    
+
     printf("Using %d threads for compression\n", num_threads);
-    
-    // Calculate chunk size
-    size_t chunk_size = file_size / num_threads;
-    // Ensure chunk size is at least 1KB
-    if (chunk_size < 1024 && num_threads > 1) {
-        chunk_size = 1024;
-        num_threads = file_size / chunk_size + (file_size % chunk_size != 0);
-        printf("Adjusted to %d threads based on minimum chunk size\n", num_threads);
-    }
-    
-    // Read file data
-    uint8_t *file_data = (uint8_t*)malloc(file_size);
-    if (!file_data) {
-        printf("Memory allocation error\n");
+
+    // Cut the input into several tasks per thread so stealing can balance skewed data
+    size_t chunk_size = file_size / ((size_t)num_threads * PARALLEL_TASKS_PER_THREAD);
+    if (chunk_size < PARALLEL_MIN_TASK_SIZE) {
+        chunk_size = PARALLEL_MIN_TASK_SIZE;
+    }
+    if (chunk_size > PARALLEL_MAX_TASK_SIZE) {
+        chunk_size = PARALLEL_MAX_TASK_SIZE;
+    }
+
+    uint64_t total_chunks = ((uint64_t)file_size + chunk_size - 1) / chunk_size;
+    if (total_chunks > INT_MAX) {
+        printf("Error: Input file too large\n");
         fclose(in);
         return 1;
     }
-    
-    fread(file_data, 1, file_size, in);
-    fclose(in);
-    
-    // Create and initialize chunks
-    ChunkInfo *chunks = (ChunkInfo*)malloc(num_threads * sizeof(ChunkInfo));
-    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
-    if (!chunks || !threads) {
+    int chunk_count = (int)total_chunks;
+
+    printf("Splitting input into %d chunks of up to %zu bytes\n", chunk_count, chunk_size);
+
+    // Allocate the ring of chunk slots
+    int slot_count = num_threads * PARALLEL_RING_SLOTS_PER_THREAD;
+    if (slot_count > chunk_count) {
+        slot_count = chunk_count;
+    }
+
+    ChunkInfo *slots = (ChunkInfo*)calloc(slot_count, sizeof(ChunkInfo));
+    if (!slots) {
         printf("Memory allocation error\n");
-        free(file_data);
-        if (chunks) free(chunks);
-        if (threads) free(threads);
+        fclose(in);
         return 1;
     }
-    
+
+    for (int i = 0; i < slot_count; i++) {
+        if (ensure_capacity(&slots[i].data, &slots[i].data_capacity, chunk_size) != 0 ||
+            ensure_capacity(&slots[i].output, &slots[i].output_capacity,
+                            algorithm->buffer_bound(chunk_size)) != 0) {
+            printf("Memory allocation error\n");
+            free_chunk_ring(slots, slot_count);
+            fclose(in);
+            return 1;
+        }
+        slots[i].algorithm = algorithm;
+    }
+
     // Prepare output file
     FILE *out = fopen(output_file, "wb");
     if (!out) {
         printf("Error opening output file: %s\n", output_file);
-        free(file_data);
-        free(chunks);
-        free(threads);
+        free_chunk_ring(slots, slot_count);
+        fclose(in);
         return 1;
     }
-    
+
     // Write header: number of chunks
-    fwrite(&num_threads, sizeof(int), 1, out);
-    
-    // Close now, we'll reopen later to append compressed chunks
-    fclose(out);
-    
-    // Create and launch threads for each chunk
-    for (int i = 0; i < num_threads; i++) {
-        size_t offset = i * chunk_size;
-        size_t current_chunk_size;
-        
-        // Calculate chunk size (last chunk may be smaller)
-        if (i == num_threads - 1) {
-            current_chunk_size = file_size - offset;
-        } else {
-            current_chunk_size = chunk_size;
-        }
-        
-        chunks[i].data = file_data + offset;
-        chunks[i].size = current_chunk_size;
-        chunks[i].original_offset = offset;
-        chunks[i].algorithm = algorithm;
-        chunks[i].thread_id = i;
-        chunks[i].output_path = create_temp_filename(output_file, i);
-        
-        if (!chunks[i].output_path) {
-            printf("Failed to create temporary filename\n");
-            // Clean up previous chunks
-            for (int j = 0; j < i; j++) {
-                free(chunks[j].output_path);
+    fwrite(&chunk_count, sizeof(int), 1, out);
+
+    int submitted = 0;
+    int result = 0;
+    uint32_t file_crc = 0;
+
+    for (int i = 0; i < chunk_count; i++) {
+        // Reader stage: fill every free slot and hand it to the pool
+        while (result == 0 && submitted < chunk_count && submitted < i + slot_count) {
+            ChunkInfo *chunk = &slots[submitted % slot_count];
+            uint64_t offset = (uint64_t)submitted * chunk_size;
+            size_t size = ((uint64_t)file_size - offset < chunk_size) ?
+                          (size_t)((uint64_t)file_size - offset) : chunk_size;
+
+            if (fread(chunk->data, 1, size, in) != size) {
+                printf("Error reading input file: %s\n", input_file);
+                result = 1;
+                break;
             }
-            free(file_data);
-            free(chunks);
-            free(threads);
-            return 1;
+
+            chunk->size = size;
+            chunk->output_size = chunk->output_capacity;
+            chunk->thread_id = submitted;
+            parallel_submit(&chunk->task, compress_chunk_task, chunk);
+            submitted++;
         }
-        
-        // Create thread
-        if (pthread_create(&threads[i], NULL, compress_chunk_thread, &chunks[i]) != 0) {
-            perror("Thread creation failed");
-            // Clean up
-            for (int j = 0; j <= i; j++) {
-                free(chunks[j].output_path);
+
+        if (i >= submitted) {
+            break;
+        }
+
+        // Writer stage: emit chunks in order as they complete
+        ChunkInfo *chunk = &slots[i % slot_count];
+        parallel_wait(&chunk->task);
+
+        if (result == 0) {
+            if (chunk->status != 0) {
+                printf("Error compressing chunk %d\n", i);
+                result = 1;
+            } else if (write_chunk_record(out, chunk->size, chunk->output, chunk->output_size) != 0) {
+                printf("Error writing compressed chunk %d\n", i);
+                result = 1;
+            } else {
+                file_crc = crc32_combine(file_crc, chunk->crc, chunk->size);
             }
-            free(file_data);
-            free(chunks);
-            free(threads);
-            return 1;
         }
     }
-    
-    // Wait for all threads to complete
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
+
+    // Trailer: CRC32 of the whole input, merged from the per-chunk CRCs
+    if (result == 0 && fwrite(&file_crc, sizeof(uint32_t), 1, out) != 1) {
+        printf("Error writing checksum\n");
+        result = 1;
     }
-    
-    // Combine all compressed chunks into the final file
-    out = fopen(output_file, "ab");
-    if (!out) {
-        printf("Error reopening output file: %s\n", output_file);
-        // Clean up
-        for (int i = 0; i < num_threads; i++) {
-            free(chunks[i].output_path);
-            remove(chunks[i].output_path);
-        }
-        free(file_data);
-        free(chunks);
-        free(threads);
+
+    fclose(in);
+    fclose(out);
+    free_chunk_ring(slots, slot_count);
+
+    if (result != 0) {
+        remove(output_file);
         return 1;
     }
-    
-    // Combine chunks
-    for (int i = 0; i < num_threads; i++) {
-        FILE *chunk_file = fopen(chunks[i].output_path, "rb");
-        if (!chunk_file) {
-            printf("Error opening chunk file: %s\n", chunks[i].output_path);
-            continue;
-        }
-        
-        // Get chunk file size
-        fseek(chunk_file, 0, SEEK_END);
-        long chunk_file_size = ftell(chunk_file);
-        fseek(chunk_file, 0, SEEK_SET);
-        
-        // Write chunk size to output
-        fwrite(&chunk_file_size, sizeof(long), 1, out);
-        
-        // Copy chunk data
-        uint8_t buffer[4096];
-        size_t bytes_read;
-        while ((bytes_read = fread(buffer, 1, sizeof(buffer), chunk_file)) > 0) {
-            fwrite(buffer, 1, bytes_read, out);
-        }
-        
-        fclose(chunk_file);
-        remove(chunks[i].output_path);
-        free(chunks[i].output_path);
-    }
-    
-    fclose(out);
-    
-    // Clean up
-    free(file_data);
-    free(chunks);
-    free(threads);
-    
+
     printf("Parallel compression completed successfully\n");
     return 0;
 }
 
 // Decompress a file in parallel using multiple threads
+// Chunk records stream through a ring of slots like compress_file_parallel
 int decompress_file_parallel(const char *input_file, const char *output_file, CompressionAlgorithm *algorithm, int num_threads) {
+    if (!algorithm || !algorithm->buffer_decompress) {
+        printf("Error: Algorithm does not support in-memory parallel decompression\n");
+        return 1;
+    }
+
     FILE *in = fopen(input_file, "rb");
     if (!in) {
         printf("Error opening input file: %s\n", input_file);
         return 1;
     }
-    
+
     // Read header: number of chunks
     int chunk_count;
-    if (fread(&chunk_count, sizeof(int), 1, in) != 1) {
+    if (fread(&chunk_count, sizeof(int), 1, in) != 1 || chunk_count <= 0) {
         printf("Error reading chunk count from file\n");
         fclose(in);
         return 1;
     }
-    
+
     printf("Decompressing file with %d chunks\n", chunk_count);
-    
+
     // Determine optimal number of threads if not specified
     if (num_threads <= 0) {
         num_threads = get_optimal_threads();
@@ -337,162 +580,108 @@ int decompress_file_parallel(const char *input_file, const char *output_file, Co
     if (num_threads > MAX_THREADS || num_threads > chunk_count) {
         num_threads = (chunk_count < MAX_THREADS) ? chunk_count : MAX_THREADS;
     }
-    
+
     printf("Using %d threads for decompression\n", num_threads);
-    
-    // Create arrays for chunk info and threads
-    ChunkInfo *chunks = (ChunkInfo*)malloc(chunk_count * sizeof(ChunkInfo));
-    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
-    if (!chunks || !threads) {
+
+    // Slot buffers grow to the largest chunk seen
+    int slot_count = num_threads * PARALLEL_RING_SLOTS_PER_THREAD;
+    if (slot_count > chunk_count) {
+        slot_count = chunk_count;
+    }
+
+    ChunkInfo *slots = (ChunkInfo*)calloc(slot_count, sizeof(ChunkInfo));
+    if (!slots) {
         printf("Memory allocation error\n");
         fclose(in);
-        if (chunks) free(chunks);
-        if (threads) free(threads);
         return 1;
     }
-    
-    // Read chunk information
-    for (int i = 0; i < chunk_count; i++) {
-        long chunk_size;
-        if (fread(&chunk_size, sizeof(long), 1, in) != 1) {
-            printf("Error reading chunk size\n");
-            fclose(in);
-            free(chunks);
-            free(threads);
-            return 1;
-        }
-        
-        chunks[i].data = (uint8_t*)malloc(chunk_size);
-        if (!chunks[i].data) {
-            printf("Memory allocation error for chunk %d\n", i);
-            // Clean up previous chunks
-            for (int j = 0; j < i; j++) {
-                free(chunks[j].data);
-            }
-            fclose(in);
-            free(chunks);
-            free(threads);
-            return 1;
-        }
-        
-        chunks[i].size = chunk_size;
-        chunks[i].algorithm = algorithm;
-        chunks[i].thread_id = i;
-        chunks[i].output_path = create_temp_filename(output_file, i);
-        
-        if (!chunks[i].output_path) {
-            printf("Failed to create temporary filename for chunk %d\n", i);
-            // Clean up
-            for (int j = 0; j <= i; j++) {
-                if (j < i) free(chunks[j].data);
-                if (chunks[j].output_path) free(chunks[j].output_path);
-            }
-            fclose(in);
-            free(chunks);
-            free(threads);
-            return 1;
-        }
-        
-        // Read chunk data
-        size_t read_size = fread(chunks[i].data, 1, chunk_size, in);
-        if ((long)read_size != (long)chunk_size) {
-            fprintf(stderr, "Error reading chunk %d: Expected %ld bytes, got %zu\n", 
-                    i, (long)chunk_size, read_size);
-            // Clean up
-            for (int j = 0; j <= i; j++) {
-                free(chunks[j].data);
-                free(chunks[j].output_path);
-            }
-            fclose(in);
-            free(chunks);
-            free(threads);
-            return 1;
-        }
-    }
-    
-    fclose(in);
-    
-    // Process chunks in batches to control memory usage
-    int remaining_chunks = chunk_count;
-    int current_chunk = 0;
-    
-    while (remaining_chunks > 0) {
-        int current_batch_size = (remaining_chunks < num_threads) ? remaining_chunks : num_threads;
-        
-        // Launch threads for current batch
-        for (int i = 0; i < current_batch_size; i++) {
-            int chunk_idx = current_chunk + i;
-            
-            if (pthread_create(&threads[i], NULL, decompress_chunk_thread, &chunks[chunk_idx]) != 0) {
-                perror("Thread creation failed");
-                // Clean up
-                for (int j = 0; j < chunk_count; j++) {
-                    free(chunks[j].data);
-                    free(chunks[j].output_path);
-                    if (j < chunk_idx) remove(chunks[j].output_path);
-                }
-                free(chunks);
-                free(threads);
-                return 1;
-            }
-        }
-        
-        // Wait for all threads in this batch to complete
-        for (int i = 0; i < current_batch_size; i++) {
-            pthread_join(threads[i], NULL);
-        }
-        
-        current_chunk += current_batch_size;
-        remaining_chunks -= current_batch_size;
-    }
-    
-    // Combine all decompressed chunks into the final file
+
     FILE *out = fopen(output_file, "wb");
     if (!out) {
         printf("Error opening output file: %s\n", output_file);
-        // Clean up
-        for (int i = 0; i < chunk_count; i++) {
-            free(chunks[i].data);
-            free(chunks[i].output_path);
-            remove(chunks[i].output_path);
-        }
-        free(chunks);
-        free(threads);
+        free(slots);
+        fclose(in);
         return 1;
     }
-    
-    // Sort chunks by original offset before combining
-    // (We'd implement a sort here if needed)
-    
-    // Combine chunks
+
+    int submitted = 0;
+    int result = 0;
+    uint32_t file_crc = 0;
+
     for (int i = 0; i < chunk_count; i++) {
-        FILE *chunk_file = fopen(chunks[i].output_path, "rb");
-        if (!chunk_file) {
-            printf("Error opening decompressed chunk file: %s\n", chunks[i].output_path);
-            continue;
+        // Reader stage: load chunk records into free slots
+        while (result == 0 && submitted < chunk_count && submitted < i + slot_count) {
+            ChunkInfo *chunk = &slots[submitted % slot_count];
+            uint64_t original_size, compressed_size;
+
+            if (fread(&original_size, sizeof(uint64_t), 1, in) != 1 ||
+                fread(&compressed_size, sizeof(uint64_t), 1, in) != 1) {
+                printf("Error reading header of chunk %d\n", submitted);
+                result = 1;
+                break;
+            }
+
+            if (original_size > SIZE_MAX || compressed_size > SIZE_MAX ||
+                ensure_capacity(&chunk->data, &chunk->data_capacity, compressed_size) != 0 ||
+                ensure_capacity(&chunk->output, &chunk->output_capacity, original_size) != 0) {
+                printf("Memory allocation error for chunk %d\n", submitted);
+                result = 1;
+                break;
+            }
+
+            size_t read_size = fread(chunk->data, 1, compressed_size, in);
+            if (read_size != compressed_size) {
+                fprintf(stderr, "Error reading chunk %d: Expected %llu bytes, got %zu\n",
+                        submitted, (unsigned long long)compressed_size, read_size);
+                result = 1;
+                break;
+            }
+
+            chunk->size = compressed_size;
+            chunk->output_size = original_size;
+            chunk->algorithm = algorithm;
+            chunk->thread_id = submitted;
+            parallel_submit(&chunk->task, decompress_chunk_task, chunk);
+            submitted++;
         }
-        
-        // Copy chunk data
-        uint8_t buffer[4096];
-        size_t bytes_read;
-        while ((bytes_read = fread(buffer, 1, sizeof(buffer), chunk_file)) > 0) {
-            fwrite(buffer, 1, bytes_read, out);
+
+        if (i >= submitted) {
+            break;
         }
-        
-        fclose(chunk_file);
-        remove(chunks[i].output_path);
+
+        // Writer stage: emit chunks in order as they complete
+        ChunkInfo *chunk = &slots[i % slot_count];
+        parallel_wait(&chunk->task);
+
+        if (result == 0) {
+            if (chunk->status != 0) {
+                printf("Error decompressing chunk %d\n", i);
+                result = 1;
+            } else if (fwrite(chunk->output, 1, chunk->output_size, out) != chunk->output_size) {
+                printf("Error writing decompressed chunk %d\n", i);
+                result = 1;
+            } else {
+                file_crc = crc32_combine(file_crc, chunk->crc, chunk->output_size);
+            }
+        }
+    }
+
+    // Verify the checksum trailer (files written before it was added end after the last chunk)
+    uint32_t stored_crc;
+    if (result == 0 && fread(&stored_crc, sizeof(uint32_t), 1, in) == 1 && stored_crc != file_crc) {
+        printf("Checksum mismatch: expected %08X, got %08X\n", stored_crc, file_crc);
+        result = 1;
     }
-    
+
+    fclose(in);
     fclose(out);
-    
-    // Clean up
-    for (int i = 0; i < chunk_count; i++) {
-        free(chunks[i].data);
-        free(chunks[i].output_path);
+    free_chunk_ring(slots, slot_count);
+
+    if (result != 0) {
+        remove(output_file);
+        return 1;
     }
-    free(chunks);
-    free(threads);
-    
+
     printf("Parallel decompression completed successfully\n");
     return 0;
-} 
\ No newline at end of file
+}
@@ -8,10 +8,38 @@
 #include <stddef.h>
 #include "compression.h"
 
+// Unit of work for the shared thread pool (storage is owned by the submitter)
+typedef struct ParallelTask {
+    void (*run)(void *arg);     // Work function
+    void *arg;                  // Argument passed to run
+    int done;                   // Set once run has returned
+    struct ParallelTask *prev;  // Deque links
+    struct ParallelTask *next;
+} ParallelTask;
+
+// Task granularity for parallel codecs: inputs are cut into many small tasks
+// so that idle workers can steal work from threads stuck on slow regions
+#define PARALLEL_MIN_TASK_SIZE (256 * 1024)
+#define PARALLEL_MAX_TASK_SIZE (4 * 1024 * 1024)
+#define PARALLEL_TASKS_PER_THREAD 4
+
+// Chunk slots per thread in the streaming pipeline (one compressing, one queued or writing)
+#define PARALLEL_RING_SLOTS_PER_THREAD 2
+
 // Function prototypes
 void init_parallel_compression(int thread_count);
+void shutdown_parallel_compression(void);
 int get_optimal_threads();
 
+// Shared work-stealing thread pool
+// Workers are started on first use and live until shutdown (or process exit)
+int parallel_pool_size(void);
+// Queue a task: on the submitting worker's own deque, or the shared queue from other threads
+// Runs the task inline if no worker thread could be started
+int parallel_submit(ParallelTask *task, void (*run)(void *arg), void *arg);
+// Wait for a task to finish, running queued tasks on the calling thread meanwhile
+void parallel_wait(ParallelTask *task);
+
 // Parallel compression and decompression functions
 int compress_file_parallel(const char *input_file, const char *output_file, 
                           CompressionAlgorithm *algorithm, int thread_count);
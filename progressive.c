@@ -2,33 +2,28 @@
  * Progressive Compression/Decompression Implementation
  * Enables partial decompression and streaming of compressed files
  */
+#define _POSIX_C_SOURCE 200809L // For strdup, pread and fseeko
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <math.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "progressive.h"
 #include "huffman.h"
 #include "lz77.h"
 #include "rle.h"
+#include "parallel.h"
+#include "crc32.h"
+#include <pthread.h>
 
-// Maximum path length for filenames
-#define MAX_PATH_LENGTH 1024
-
-// Temporary files for RLE operations
-#define TEMP_INPUT_FILE "temp_input.dat"
-// TEMP_OUTPUT_FILE is already defined in progressive.h
-
-/* 
- * These functions are currently unused but may be needed for future extensions.
- * Marking them as static and with __attribute__((unused)) to avoid warnings.
- */
- 
-#ifdef __GNUC__
-static int __attribute__((unused)) write_header(FILE* file, ProgressiveHeader* header) {
-#else
+// Helper function to write a header to a file
 static int write_header(FILE* file, ProgressiveHeader* header) {
-#endif
     // Write magic number
     if (fwrite(header->magic, 1, 4, file) != 4) {
         return 0;
@@ -48,6 +43,12 @@ static int write_header(FILE* file, ProgressiveHeader* header) {
         return 0;
     }
     
+    // Write block index location
+    if (header->version >= 2 &&
+        fwrite(&header->index_offset, sizeof(uint64_t), 1, file) != 1) {
+        return 0;
+    }
+    
     // Write checksum if present
     if (header->flags & FLAG_HAS_CHECKSUM) {
         size_t checksum_size = get_checksum_size(header->checksum.type);
@@ -73,6 +74,11 @@ static int write_header(FILE* file, ProgressiveHeader* header) {
                         return 0;
                     }
                     break;
+                case CHECKSUM_XXH64:
+                    if (fwrite(&header->checksum.xxh64, sizeof(uint64_t), 1, file) != 1) {
+                        return 0;
+                    }
+                    break;
                 default:
                     break;
             }
@@ -115,6 +121,19 @@ static int read_header(FILE* file, ProgressiveHeader* header) {
         return 0;
     }
     
+    // Byte offsets are mapped onto blocks by block size, so it must be sane
+    if (header->block_size == 0 || header->block_size > MAX_BLOCK_SIZE) {
+        fprintf(stderr, "Invalid block size: %u\n", header->block_size);
+        return 0;
+    }
+    
+    // Read block index location
+    header->index_offset = 0;
+    if (header->version >= 2 &&
+        fread(&header->index_offset, sizeof(uint64_t), 1, file) != 1) {
+        return 0;
+    }
+    
     // Read checksum if present
     if (header->flags & FLAG_HAS_CHECKSUM) {
         if (fread(&header->checksum.type, sizeof(ChecksumType), 1, file) != 1) {
@@ -138,31 +157,82 @@ static int read_header(FILE* file, ProgressiveHeader* header) {
                     return 0;
                 }
                 break;
-            default:
+            case CHECKSUM_XXH64:
+                if (fread(&header->checksum.xxh64, sizeof(uint64_t), 1, file) != 1) {
+                    return 0;
+                }
                 break;
+            default:
+                // Unknown checksum type: block headers could not be sized
+                return 0;
         }
     }
     
     return 1;
 }
 
-#ifdef __GNUC__
-static int __attribute__((unused)) write_block_header(FILE* file, BlockHeader* header) {
-#else
+// Size of the serialized file header
+static uint64_t get_header_size(const ProgressiveHeader* header) {
+    uint64_t size = 4 + 3 + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+    if (header->version >= 2) {
+        size += sizeof(uint64_t); // Block index location
+    }
+    if (header->flags & FLAG_HAS_CHECKSUM) {
+        size += sizeof(ChecksumType) + get_checksum_size(header->checksum.type);
+    }
+    return size;
+}
+
+// Size of a serialized block header (the checksum type is taken from the file header)
+static size_t get_block_header_size(const ProgressiveHeader* header) {
+    size_t size = sizeof(uint32_t) * 3; // ID, compressed size, original size
+    if (header->version >= 4) {
+        size += sizeof(uint8_t); // Codec
+    }
+    if (header->flags & FLAG_HAS_CHECKSUM) {
+        size += get_checksum_size(header->checksum.type);
+    }
+    return size;
+}
+
+// Codecs the compressor chooses between for each block
+static const uint8_t block_codecs[] = { HUFFMAN, LZ77, RLE };
+#define BLOCK_CODEC_COUNT (sizeof(block_codecs) / sizeof(block_codecs[0]))
+
+// Largest block record payload a file may contain
+// Version 4 blocks may use any block codec; older files use the file algorithm
+static size_t get_record_capacity(const ProgressiveHeader* header) {
+    size_t capacity = compress_bound(header->algorithm, header->block_size);
+    if (capacity == 0) {
+        return 0;
+    }
+    if (header->version >= 4) {
+        for (size_t i = 0; i < BLOCK_CODEC_COUNT; i++) {
+            size_t bound = compress_bound(block_codecs[i], header->block_size);
+            if (bound > capacity) {
+                capacity = bound;
+            }
+        }
+    }
+    return capacity > header->block_size ? capacity : header->block_size;
+}
+
+// Whether a block holds its data uncompressed
+static int block_is_stored(const BlockHeader* block_header) {
+    return block_header->codec == BLOCK_CODEC_STORED;
+}
+
+// Helper function to write a block header
 static int write_block_header(FILE* file, BlockHeader* header) {
-#endif
     if (fwrite(&header->block_id, sizeof(uint32_t), 1, file) != 1 ||
         fwrite(&header->compressed_size, sizeof(uint32_t), 1, file) != 1 ||
-        fwrite(&header->original_size, sizeof(uint32_t), 1, file) != 1) {
+        fwrite(&header->original_size, sizeof(uint32_t), 1, file) != 1 ||
+        fwrite(&header->codec, sizeof(uint8_t), 1, file) != 1) {
         return 0;
     }
     
     // Write block checksum if used
     if (header->block_checksum.type != CHECKSUM_NONE) {
-        if (fwrite(&header->block_checksum.type, sizeof(ChecksumType), 1, file) != 1) {
-            return 0;
-        }
-        
         // Write the checksum data based on type
         switch (header->block_checksum.type) {
             case CHECKSUM_CRC32:
@@ -180,6 +250,11 @@ static int write_block_header(FILE* file, BlockHeader* header) {
                     return 0;
                 }
                 break;
+            case CHECKSUM_XXH64:
+                if (fwrite(&header->block_checksum.xxh64, sizeof(uint64_t), 1, file) != 1) {
+                    return 0;
+                }
+                break;
             default:
                 break;
         }
@@ -188,34 +263,41 @@ static int write_block_header(FILE* file, BlockHeader* header) {
     return 1;
 }
 
-// Helper function to read a block header
-static int read_block_header(FILE* file, BlockHeader* header, uint8_t has_checksum, ChecksumType checksum_type) {
-    if (fread(&header->block_id, sizeof(uint32_t), 1, file) != 1 ||
-        fread(&header->compressed_size, sizeof(uint32_t), 1, file) != 1 ||
-        fread(&header->original_size, sizeof(uint32_t), 1, file) != 1) {
-        return 0;
+// Helper function to parse a block header from memory
+static void parse_block_header(const uint8_t* data, BlockHeader* header, const ProgressiveHeader* file_header) {
+    ChecksumType checksum_type = file_header->checksum.type;
+    
+    memcpy(&header->block_id, data, sizeof(uint32_t));
+    memcpy(&header->compressed_size, data + 4, sizeof(uint32_t));
+    memcpy(&header->original_size, data + 8, sizeof(uint32_t));
+    data += sizeof(uint32_t) * 3;
+    
+    // Older files use the file algorithm, with version 3 storing blocks that did not shrink
+    if (file_header->version >= 4) {
+        header->codec = *data++;
+    } else if (file_header->version == 3 && header->compressed_size == header->original_size) {
+        header->codec = BLOCK_CODEC_STORED;
+    } else {
+        header->codec = file_header->algorithm;
     }
     
-    // Read block checksum if used
-    if (has_checksum) {
+    // Parse block checksum if used
+    if (file_header->flags & FLAG_HAS_CHECKSUM) {
         header->block_checksum.type = checksum_type;
         
         // Read the checksum data based on type
         switch (checksum_type) {
             case CHECKSUM_CRC32:
-                if (fread(&header->block_checksum.crc32, sizeof(uint32_t), 1, file) != 1) {
-                    return 0;
-                }
+                memcpy(&header->block_checksum.crc32, data, sizeof(uint32_t));
                 break;
             case CHECKSUM_MD5:
-                if (fread(header->block_checksum.md5, 1, 16, file) != 16) {
-                    return 0;
-                }
+                memcpy(header->block_checksum.md5, data, 16);
                 break;
             case CHECKSUM_SHA256:
-                if (fread(header->block_checksum.sha256, 1, 32, file) != 32) {
-                    return 0;
-                }
+                memcpy(header->block_checksum.sha256, data, 32);
+                break;
+            case CHECKSUM_XXH64:
+                memcpy(&header->block_checksum.xxh64, data, sizeof(uint64_t));
                 break;
             default:
                 break;
@@ -223,7 +305,91 @@ static int read_block_header(FILE* file, BlockHeader* header, uint8_t has_checks
     } else {
         header->block_checksum.type = CHECKSUM_NONE;
     }
+}
+
+// Helper function to read a block header
+static int read_block_header(FILE* file, BlockHeader* header, const ProgressiveHeader* file_header) {
+    uint8_t data[sizeof(uint32_t) * 3 + sizeof(uint8_t) + 32];
+    size_t size = get_block_header_size(file_header);
+    
+    if (size > sizeof(data) || fread(data, 1, size, file) != size) {
+        return 0;
+    }
+    
+    parse_block_header(data, header, file_header);
+    return 1;
+}
+
+// Read size bytes at an absolute file offset without disturbing the stream position
+static int read_at(FILE* file, uint8_t* buffer, size_t size, uint64_t offset) {
+#ifdef _WIN32
+    if (_fseeki64(file, (__int64)offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    return fread(buffer, 1, size, file) == size;
+#else
+    int fd = fileno(file);
+    size_t done = 0;
+    
+    while (done < size) {
+        ssize_t n = pread(fd, buffer + done, size - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        done += (size_t)n;
+    }
+    return 1;
+#endif
+}
+
+// Load the block index footer referenced by the header
+static int load_block_index(ProgressiveContext* context) {
+    ProgressiveHeader* header = &context->header;
+    uint32_t count = header->total_blocks;
+    
+    if (count == 0) {
+        return 1;
+    }
+    
+    uint8_t* data = (uint8_t*)malloc((size_t)count * BLOCK_INDEX_ENTRY_SIZE);
+    context->block_index = (BlockIndexEntry*)malloc(count * sizeof(BlockIndexEntry));
+    if (!data || !context->block_index) {
+        free(data);
+        return 0;
+    }
+    
+    if (!read_at(context->file, data, (size_t)count * BLOCK_INDEX_ENTRY_SIZE, header->index_offset)) {
+        free(data);
+        return 0;
+    }
+    
+    // Validate every entry once so block reads can trust the index
+    size_t block_capacity = get_record_capacity(header);
+    uint64_t data_start = get_header_size(header);
+    size_t block_header_size = get_block_header_size(header);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        BlockIndexEntry* entry = &context->block_index[i];
+        const uint8_t* record = data + (size_t)i * BLOCK_INDEX_ENTRY_SIZE;
+        
+        memcpy(&entry->offset, record, sizeof(uint64_t));
+        memcpy(&entry->compressed_size, record + 8, sizeof(uint32_t));
+        memcpy(&entry->original_size, record + 12, sizeof(uint32_t));
+        
+        if (entry->offset < data_start ||
+            entry->compressed_size > block_capacity ||
+            entry->original_size > header->block_size ||
+            entry->offset + block_header_size + entry->compressed_size > header->index_offset) {
+            fprintf(stderr, "Invalid block index entry %u\n", i);
+            free(data);
+            return 0;
+        }
+    }
     
+    free(data);
     return 1;
 }
 
@@ -233,23 +399,22 @@ static int64_t find_block_location(ProgressiveContext* context, uint32_t block_i
         return -1; // Invalid input
     }
     
+    // Files with a block index know every block location
+    if (context->block_index) {
+        return (int64_t)context->block_index[block_id].offset;
+    }
+    
     // If this is the next sequential block, we're already positioned correctly
     if (block_id == (uint32_t)(context->last_block_id + 1)) {
         return context->current_pos;
     }
     
     // Calculate the size of the file header
-    uint64_t header_size = 4 + 3 + sizeof(uint32_t) * 2 + sizeof(uint64_t);
-    if (context->header.flags & FLAG_HAS_CHECKSUM) {
-        header_size += sizeof(ChecksumType) + get_checksum_size(context->header.checksum.type);
-    }
+    uint64_t header_size = get_header_size(&context->header);
     
     // We need to scan from the beginning until we find the block
     // First, calculate the size of a block header
-    size_t block_header_size = sizeof(uint32_t) * 3; // ID, compressed size, original size
-    if (context->header.flags & FLAG_HAS_CHECKSUM) {
-        block_header_size += sizeof(ChecksumType) + get_checksum_size(context->header.checksum.type);
-    }
+    size_t block_header_size = get_block_header_size(&context->header);
     
     // If we have a file with a direct access table (streaming optimized flag), we can jump directly
     if (context->header.flags & FLAG_STREAMING_OPTIMIZED) {
@@ -272,12 +437,10 @@ static int64_t find_block_location(ProgressiveContext* context, uint32_t block_i
     
     uint64_t current_pos = header_size;
     BlockHeader block_header;
-    uint8_t has_checksum = context->header.flags & FLAG_HAS_CHECKSUM;
-    ChecksumType checksum_type = context->header.checksum.type;
     
     for (uint32_t i = 0; i < block_id; i++) {
         // Read the block header
-        if (!read_block_header(context->file, &block_header, has_checksum, checksum_type)) {
+        if (!read_block_header(context->file, &block_header, &context->header)) {
             return -1;
         }
         
@@ -292,8 +455,182 @@ static int64_t find_block_location(ProgressiveContext* context, uint32_t block_i
     return current_pos;
 }
 
-// Create a new progressive context
-ProgressiveContext* progressive_init(const char* filename) {
+// Remove an entry from the LRU list
+static void cache_unlink(BlockCache* cache, BlockCacheEntry* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+// Insert an entry at the most recently used end of the LRU list
+static void cache_push_front(BlockCache* cache, BlockCacheEntry* entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+// Find a cached block
+static BlockCacheEntry* cache_find(const BlockCache* cache, uint32_t block_id) {
+    BlockCacheEntry* entry = cache->buckets[block_id & cache->bucket_mask];
+    while (entry && entry->block_id != block_id) {
+        entry = entry->hash_next;
+    }
+    return entry;
+}
+
+// Remove an entry from its bucket
+static void cache_remove_from_bucket(BlockCache* cache, BlockCacheEntry* entry) {
+    BlockCacheEntry** link = &cache->buckets[entry->block_id & cache->bucket_mask];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    entry->hash_next = NULL;
+}
+
+// Drop the least recently used entry, returning it detached from the cache
+static BlockCacheEntry* cache_evict(BlockCache* cache) {
+    BlockCacheEntry* entry = cache->tail;
+    cache_unlink(cache, entry);
+    cache_remove_from_bucket(cache, entry);
+    cache->entry_count--;
+    cache->evictions++;
+    return entry;
+}
+
+// Free a cache entry
+static void cache_free_entry(BlockCacheEntry* entry) {
+    free(entry->data);
+    free(entry);
+}
+
+// Set the memory budget of the decoded block cache
+int progressive_set_cache_size(ProgressiveContext* context, size_t max_bytes) {
+    if (!context) {
+        return 0;
+    }
+    
+    BlockCache* cache = &context->cache;
+    size_t max_entries = context->header.block_size ? max_bytes / context->header.block_size : 0;
+    if (max_entries > context->header.total_blocks) {
+        max_entries = context->header.total_blocks;
+    }
+    
+    // Size the lookup table first so a failed allocation leaves the cache untouched
+    BlockCacheEntry** buckets = NULL;
+    size_t bucket_count = 0;
+    if (max_entries > 0) {
+        bucket_count = 1;
+        while (bucket_count < max_entries * 2) {
+            bucket_count <<= 1;
+        }
+        buckets = (BlockCacheEntry**)calloc(bucket_count, sizeof(BlockCacheEntry*));
+        if (!buckets) {
+            fprintf(stderr, "Memory allocation error\n");
+            return 0;
+        }
+    }
+    
+    pthread_mutex_lock(&context->cache_lock);
+    
+    while (cache->entry_count > max_entries) {
+        cache_free_entry(cache_evict(cache));
+    }
+    
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_mask = bucket_count ? bucket_count - 1 : 0;
+    cache->max_entries = max_entries;
+    
+    // Rehash the surviving entries
+    for (BlockCacheEntry* entry = cache->head; entry; entry = entry->next) {
+        BlockCacheEntry** bucket = &cache->buckets[entry->block_id & cache->bucket_mask];
+        entry->hash_next = *bucket;
+        *bucket = entry;
+    }
+    
+    pthread_mutex_unlock(&context->cache_lock);
+    return 1;
+}
+
+// Get decoded block cache statistics
+void progressive_get_cache_stats(ProgressiveContext* context, BlockCacheStats* stats) {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(BlockCacheStats));
+    if (!context) {
+        return;
+    }
+    
+    pthread_mutex_lock(&context->cache_lock);
+    stats->hits = context->cache.hits;
+    stats->misses = context->cache.misses;
+    stats->evictions = context->cache.evictions;
+    stats->entries = context->cache.entry_count;
+    stats->bytes_used = context->cache.entry_count * context->header.block_size;
+    stats->capacity = context->cache.max_entries * context->header.block_size;
+    pthread_mutex_unlock(&context->cache_lock);
+}
+
+// Map the whole archive read-only so blocks can be decoded in place
+// Returns 1 on success, 0 if the file cannot be mapped (the context keeps using stream reads)
+static int map_archive(ProgressiveContext* context) {
+#ifdef _WIN32
+    (void)context;
+    return 0;
+#else
+    struct stat st;
+    if (fstat(fileno(context->file), &st) != 0 || st.st_size <= 0 ||
+        (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        return 0;
+    }
+    
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(context->file), 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    
+    context->map = (const uint8_t*)map;
+    context->map_size = (uint64_t)st.st_size;
+    return 1;
+#endif
+}
+
+// Give the kernel a hint about how a mapped context will be read
+int progressive_advise(ProgressiveContext* context, ProgressiveAccess access) {
+    if (!context || !context->map) {
+        return 0;
+    }
+#ifdef _WIN32
+    (void)access;
+    return 0;
+#else
+    int advice = POSIX_MADV_NORMAL;
+    if (access == PROGRESSIVE_ACCESS_SEQUENTIAL) {
+        advice = POSIX_MADV_SEQUENTIAL;
+    } else if (access == PROGRESSIVE_ACCESS_RANDOM) {
+        advice = POSIX_MADV_RANDOM;
+    }
+    return posix_madvise((void*)context->map, (size_t)context->map_size, advice) == 0;
+#endif
+}
+
+// Open a progressive file, optionally mapping it into memory
+static ProgressiveContext* open_context(const char* filename, int mapped, ProgressiveAccess access) {
     if (!filename) {
         return NULL;
     }
@@ -307,12 +644,15 @@ ProgressiveContext* progressive_init(const char* filename) {
     
     // Initialize with zeros
     memset(context, 0, sizeof(ProgressiveContext));
+    pthread_mutex_init(&context->file_lock, NULL);
+    pthread_mutex_init(&context->cache_lock, NULL);
+    context->last_block_id = -1; // No blocks processed yet
     
     // Open the file
     context->file = fopen(filename, "rb");
     if (!context->file) {
         fprintf(stderr, "Error opening file: %s\n", filename);
-        free(context);
+        progressive_free(context);
         return NULL;
     }
     
@@ -320,108 +660,78 @@ ProgressiveContext* progressive_init(const char* filename) {
     context->filename = strdup(filename);
     if (!context->filename) {
         fprintf(stderr, "Memory allocation error\n");
-        fclose(context->file);
-        free(context);
+        progressive_free(context);
         return NULL;
     }
     
     // Read the header
     if (!read_header(context->file, &context->header)) {
         fprintf(stderr, "Error reading file header\n");
-        fclose(context->file);
-        free(context->filename);
-        free(context);
+        progressive_free(context);
         return NULL;
     }
     
-    // Allocate block buffer
-    context->block_buffer = (uint8_t*)malloc(context->header.block_size);
-    if (!context->block_buffer) {
-        fprintf(stderr, "Memory allocation error\n");
-        fclose(context->file);
-        free(context->filename);
-        free(context);
+    // Compressed blocks may be larger than the block size
+    if (get_record_capacity(&context->header) == 0) {
+        fprintf(stderr, "Unsupported algorithm in progressive file: %u\n", context->header.algorithm);
+        progressive_free(context);
         return NULL;
     }
     
-    // Allocate output buffer (will be at least the size of the block)
-    context->output_buffer = (uint8_t*)malloc(context->header.block_size * 2);
-    if (!context->output_buffer) {
-        fprintf(stderr, "Memory allocation error\n");
-        fclose(context->file);
-        free(context->filename);
-        free(context->block_buffer);
-        free(context);
+    // Load the block index so blocks can be located without scanning
+    if (context->header.version >= 2 && context->header.index_offset != 0 &&
+        !load_block_index(context)) {
+        fprintf(stderr, "Error reading block index\n");
+        progressive_free(context);
         return NULL;
     }
     
-    // Initialize algorithm-specific context
-    // For Huffman, read the tree from the beginning of the file
-    if (context->header.algorithm == HUFFMAN || context->header.algorithm == HUFFMAN_PARALLEL) {
-        printf("DEBUG: Initializing Huffman tree\n");
-        
-        // Create a simple Huffman tree for decoding
-        // In a real implementation, the tree would be serialized and stored in the file
-        HuffmanContext* huffman_context = huffman_context_init();
-        if (!huffman_context) {
-            fprintf(stderr, "Failed to initialize Huffman context\n");
-            fclose(context->file);
-            free(context->filename);
-            free(context->block_buffer);
-            free(context->output_buffer);
-            free(context);
-            return NULL;
-        }
-        
-        // Build a default tree with basic ASCII frequencies
-        // This is a simplified approach - in a real implementation,
-        // the actual tree would be stored in the file header
-        for (int i = 0; i < 256; i++) {
-            // Add a basic frequency distribution - higher for common characters
-            if (i >= 'a' && i <= 'z')
-                huffman_context->frequency[i] = 100 + (i - 'a');
-            else if (i >= 'A' && i <= 'Z')
-                huffman_context->frequency[i] = 50 + (i - 'A');
-            else if (i >= '0' && i <= '9')
-                huffman_context->frequency[i] = 30 + (i - '0');
-            else if (i == ' ')
-                huffman_context->frequency[i] = 200;
-            else if (i == '\n')
-                huffman_context->frequency[i] = 40;
-            else
-                huffman_context->frequency[i] = 10;
-        }
-        
-        // Build the Huffman tree
-        huffman_build_tree_and_codes(huffman_context);
-        
-        // Store the root node in our context
-        context->huffman_tree = huffman_context->tree_root;
-        
-        // Free the context but not the tree
-        huffman_context->tree_root = NULL; // Prevent the tree from being freed
-        huffman_context_free(huffman_context);
-        
-        printf("DEBUG: Huffman tree initialized successfully\n");
-    }
+    // Keep recently decoded blocks around for repeated reads
+    progressive_set_cache_size(context, DEFAULT_BLOCK_CACHE_SIZE);
     
-    context->last_block_id = -1; // No blocks processed yet
     context->current_pos = ftell(context->file);
-    context->initialized = 1;
     
+    if (mapped && map_archive(context)) {
+        progressive_advise(context, access);
+    }
+    
+    context->initialized = 1;
     return context;
 }
 
+// Create a new progressive context
+ProgressiveContext* progressive_init(const char* filename) {
+    return open_context(filename, 0, PROGRESSIVE_ACCESS_NORMAL);
+}
+
+// Create a progressive context reading blocks straight from a memory mapping
+ProgressiveContext* progressive_init_mapped(const char* filename, ProgressiveAccess access) {
+    return open_context(filename, 1, access);
+}
+
 // Free a progressive context
 void progressive_free(ProgressiveContext* context) {
     if (!context) {
         return;
     }
     
-    // Free algorithm-specific resources
-    if (context->huffman_tree) {
-        free_huffman_tree(context->huffman_tree);
+    // Release cached blocks
+    progressive_set_cache_size(context, 0);
+    
+    // Release scratch buffers
+    while (context->scratch) {
+        ReadScratch* scratch = context->scratch;
+        context->scratch = scratch->next;
+        free(scratch->record);
+        free(scratch->block);
+        free(scratch);
+    }
+    
+#ifndef _WIN32
+    if (context->map) {
+        munmap((void*)context->map, (size_t)context->map_size);
     }
+#endif
     
     // Free other resources
     if (context->file) {
@@ -430,278 +740,626 @@ void progressive_free(ProgressiveContext* context) {
     if (context->filename) {
         free(context->filename);
     }
-    if (context->block_buffer) {
-        free(context->block_buffer);
-    }
-    if (context->output_buffer) {
-        free(context->output_buffer);
-    }
+    free(context->block_index);
     
+    pthread_mutex_destroy(&context->file_lock);
+    pthread_mutex_destroy(&context->cache_lock);
     free(context);
 }
 
-#ifdef __GNUC__
-static int __attribute__((unused)) decompress_rle_with_temp_files(const uint8_t* input, size_t input_size, 
-                                         uint8_t* output, size_t max_output_size, 
-                                         size_t* output_size) {
-#else
-static int decompress_rle_with_temp_files(const uint8_t* input, size_t input_size, 
-                                         uint8_t* output, size_t max_output_size, 
-                                         size_t* output_size) {
-#endif
-    // Create a temporary input file
-    FILE* temp_in = fopen(TEMP_INPUT_FILE, "wb");
-    if (!temp_in) {
-        fprintf(stderr, "Error creating temporary input file\n");
-        return -1;
-    }
+// Read a block record by scanning the file stream (files without a block index)
+// Caller must hold file_lock, since this moves the shared stream position
+static int scan_block_record(ProgressiveContext* context, uint32_t block_id, uint8_t* record, BlockHeader* block_header) {
+    size_t block_header_size = get_block_header_size(&context->header);
     
-    // Write the compressed data to the temp file
-    if (fwrite(input, 1, input_size, temp_in) != input_size) {
-        fprintf(stderr, "Error writing to temporary input file\n");
-        fclose(temp_in);
-        return -1;
+    // Find the block in the file
+    if (find_block_location(context, block_id) < 0) {
+        fprintf(stderr, "Error finding block %u\n", block_id);
+        return 0;
     }
     
-    fclose(temp_in);
-    
-    // Decompress using RLE
-    int result = decompress_rle(TEMP_INPUT_FILE, TEMP_OUTPUT_FILE);
-    if (result != 0) {
-        fprintf(stderr, "Error decompressing RLE data\n");
-        remove(TEMP_INPUT_FILE);
-        return -1;
+    // Read the block header
+    if (!read_block_header(context->file, block_header, &context->header)) {
+        fprintf(stderr, "Error reading block header\n");
+        return 0;
     }
     
-    // Read the decompressed data from the temp output file
-    FILE* temp_out = fopen(TEMP_OUTPUT_FILE, "rb");
-    if (!temp_out) {
-        fprintf(stderr, "Error opening temporary output file\n");
-        remove(TEMP_INPUT_FILE);
-        return -1;
+    // Make sure the compressed block fits the record buffer
+    if (block_header->compressed_size > get_record_capacity(&context->header)) {
+        fprintf(stderr, "Invalid compressed size %u for block %u\n", block_header->compressed_size, block_id);
+        return 0;
     }
     
-    // Get file size
-    fseek(temp_out, 0, SEEK_END);
-    long file_size = ftell(temp_out);
-    rewind(temp_out);
-    
-    if (file_size > (long)max_output_size) {
-        fprintf(stderr, "Output buffer too small for decompressed data\n");
-        fclose(temp_out);
-        remove(TEMP_INPUT_FILE);
-        remove(TEMP_OUTPUT_FILE);
-        return -1;
+    // Read the compressed block data
+    size_t read_bytes = fread(record + block_header_size, 1, block_header->compressed_size, context->file);
+    if (read_bytes != block_header->compressed_size) {
+        fprintf(stderr, "Error reading block data: read %zu of %u bytes\n", 
+                read_bytes, block_header->compressed_size);
+        return 0;
     }
     
-    // Read the decompressed data
-    *output_size = fread(output, 1, file_size, temp_out);
-    
-    // Close and clean up
-    fclose(temp_out);
-    remove(TEMP_INPUT_FILE);
-    remove(TEMP_OUTPUT_FILE);
-    
-    return 0;
+    context->current_pos = ftell(context->file);
+    context->last_block_id = block_id;
+    return 1;
 }
 
-#ifdef __GNUC__
-static int __attribute__((unused)) compress_rle_with_temp_files(const uint8_t* input, size_t input_size, 
-                                       uint8_t* output, size_t max_output_size,
-                                       size_t* output_size) {
-#else
-static int compress_rle_with_temp_files(const uint8_t* input, size_t input_size, 
-                                       uint8_t* output, size_t max_output_size,
-                                       size_t* output_size) {
-#endif
-    // Create a temporary input file
-    FILE* temp_in = fopen(TEMP_INPUT_FILE, "wb");
-    if (!temp_in) {
-        fprintf(stderr, "Error creating temporary input file\n");
-        return -1;
+// Locate the record of a block inside the file mapping, without copying it
+static const uint8_t* map_block_record(ProgressiveContext* context, uint32_t block_id, BlockHeader* block_header) {
+    size_t block_header_size = get_block_header_size(&context->header);
+    uint64_t offset;
+    
+    if (context->block_index) {
+        offset = context->block_index[block_id].offset;
+    } else {
+        // Without an index the block is found by scanning the stream
+        pthread_mutex_lock(&context->file_lock);
+        int64_t location = find_block_location(context, block_id);
+        pthread_mutex_unlock(&context->file_lock);
+        if (location < 0) {
+            fprintf(stderr, "Error finding block %u\n", block_id);
+            return NULL;
+        }
+        offset = (uint64_t)location;
     }
     
-    // Write the input data to the temp file
-    if (fwrite(input, 1, input_size, temp_in) != input_size) {
-        fprintf(stderr, "Error writing to temporary input file\n");
-        fclose(temp_in);
-        return -1;
+    if (offset > context->map_size || context->map_size - offset < block_header_size) {
+        fprintf(stderr, "Block %u lies outside the file\n", block_id);
+        return NULL;
     }
     
-    fclose(temp_in);
+    const uint8_t* record = context->map + offset;
+    parse_block_header(record, block_header, &context->header);
     
-    // Compress using RLE
-    int result = compress_rle(TEMP_INPUT_FILE, TEMP_OUTPUT_FILE);
-    if (result != 0) {
-        fprintf(stderr, "Error compressing RLE data\n");
-        remove(TEMP_INPUT_FILE);
-        return -1;
+    if (block_header->compressed_size > get_record_capacity(&context->header) ||
+        context->map_size - offset - block_header_size < block_header->compressed_size) {
+        fprintf(stderr, "Invalid compressed size %u for block %u\n", block_header->compressed_size, block_id);
+        return NULL;
     }
     
-    // Read the compressed data from the temp output file
-    FILE* temp_out = fopen(TEMP_OUTPUT_FILE, "rb");
-    if (!temp_out) {
-        fprintf(stderr, "Error opening temporary output file\n");
-        remove(TEMP_INPUT_FILE);
-        return -1;
+    if (context->block_index) {
+        const BlockIndexEntry* entry = &context->block_index[block_id];
+        if (block_header->compressed_size != entry->compressed_size ||
+            block_header->original_size != entry->original_size) {
+            fprintf(stderr, "Block %u does not match the block index\n", block_id);
+            return NULL;
+        }
+    } else {
+        // Remember where the next block starts so sequential reads need no scan
+        pthread_mutex_lock(&context->file_lock);
+        context->current_pos = offset + block_header_size + block_header->compressed_size;
+        context->last_block_id = block_id;
+        pthread_mutex_unlock(&context->file_lock);
     }
     
-    // Get file size
-    fseek(temp_out, 0, SEEK_END);
-    long file_size = ftell(temp_out);
-    rewind(temp_out);
-    
-    if (file_size > (long)max_output_size) {
-        fprintf(stderr, "Output buffer too small for compressed data\n");
-        fclose(temp_out);
-        remove(TEMP_INPUT_FILE);
-        remove(TEMP_OUTPUT_FILE);
-        return -1;
+    return record;
+}
+
+// Get the record (header and compressed data) of a block
+// Mapped contexts return a pointer into the mapping; otherwise the record is read into
+// record. With a block index this is a single positioned read that any number of
+// threads may issue at once; otherwise the file is scanned under the file lock.
+// Returns the record, or NULL on error
+static const uint8_t* read_block_record(ProgressiveContext* context, uint32_t block_id, uint8_t* record,
+                                        BlockHeader* block_header) {
+    size_t block_header_size = get_block_header_size(&context->header);
+    
+    if (context->map) {
+        return map_block_record(context, block_id, block_header);
+    }
+    
+    if (!context->block_index) {
+        pthread_mutex_lock(&context->file_lock);
+        int result = scan_block_record(context, block_id, record, block_header);
+        pthread_mutex_unlock(&context->file_lock);
+        return result ? record : NULL;
     }
     
-    // Read the compressed data
-    *output_size = fread(output, 1, file_size, temp_out);
+    const BlockIndexEntry* entry = &context->block_index[block_id];
     
-    // Close and clean up
-    fclose(temp_out);
-    remove(TEMP_INPUT_FILE);
-    remove(TEMP_OUTPUT_FILE);
+#ifdef _WIN32
+    // Positioned reads seek the shared stream on Windows
+    pthread_mutex_lock(&context->file_lock);
+#endif
+    int read_ok = read_at(context->file, record, block_header_size + entry->compressed_size, entry->offset);
+#ifdef _WIN32
+    pthread_mutex_unlock(&context->file_lock);
+#endif
+    if (!read_ok) {
+        fprintf(stderr, "Error reading block %u\n", block_id);
+        return NULL;
+    }
     
-    return 0;
+    parse_block_header(record, block_header, &context->header);
+    
+    if (block_header->compressed_size != entry->compressed_size ||
+        block_header->original_size != entry->original_size) {
+        fprintf(stderr, "Block %u does not match the block index\n", block_id);
+        return NULL;
+    }
+    return record;
 }
 
-// Decompress a specific block by ID
-int64_t progressive_decompress_block(ProgressiveContext* context, uint32_t block_id, uint8_t* output, size_t output_size) {
-    if (!context || !context->initialized || !output || block_id >= context->header.total_blocks) {
-        fprintf(stderr, "DEBUG: Invalid context or parameters\n");
-        return -1;
+// Check that a block record is the expected block and its data is intact
+static int verify_block_record(const ProgressiveContext* context, uint32_t block_id, const BlockHeader* block_header,
+                               const uint8_t* block_data) {
+    // Make sure this is the block we expected
+    if (block_header->block_id != block_id) {
+        fprintf(stderr, "Block ID mismatch: expected %u, got %u\n", block_id, block_header->block_id);
+        return 0;
     }
     
-    printf("DEBUG: Finding block %u\n", block_id);
+    // Stored data is the block itself
+    if (block_is_stored(block_header) && block_header->compressed_size != block_header->original_size) {
+        fprintf(stderr, "Stored block %u has inconsistent sizes\n", block_id);
+        return 0;
+    }
     
-    // Find the block in the file
-    if (find_block_location(context, block_id) < 0) {
-        fprintf(stderr, "Error finding block %u\n", block_id);
-        return -1;
+    // Verify checksum if present (MD5 and SHA256 before version 5 were not real digests and cannot be checked)
+    if ((context->header.flags & FLAG_HAS_CHECKSUM) &&
+        (context->header.version >= 5 || block_header->block_checksum.type == CHECKSUM_CRC32)) {
+        if (!verify_checksum(block_data, block_header->compressed_size, &block_header->block_checksum)) {
+            fprintf(stderr, "Block checksum verification failed\n");
+            return 0;
+        }
     }
     
-    printf("DEBUG: Found block at position %ld\n", ftell(context->file));
+    return 1;
+}
+
+// Verify and decode a block record into output
+// Only reads the context header, so records can be decoded on several threads at once
+static int64_t decode_block_record(const ProgressiveContext* context, uint32_t block_id, const BlockHeader* block_header,
+                                   const uint8_t* record, uint8_t* output, size_t output_size) {
+    const uint8_t* block_data = record + get_block_header_size(&context->header);
     
-    // Read the block header
-    BlockHeader block_header;
-    uint8_t has_checksum = context->header.flags & FLAG_HAS_CHECKSUM;
-    ChecksumType checksum_type = context->header.checksum.type;
-    if (!read_block_header(context->file, &block_header, has_checksum, checksum_type)) {
-        fprintf(stderr, "Error reading block header\n");
+    // Check output buffer size
+    if (output_size < block_header->original_size) {
+        fprintf(stderr, "Output buffer too small: need %u bytes, got %zu\n", 
+                block_header->original_size, output_size);
         return -1;
     }
     
-    printf("DEBUG: Block header read successfully\n");
-    printf("DEBUG: Block ID: %u\n", block_header.block_id);
-    printf("DEBUG: Compressed size: %u\n", block_header.compressed_size);
-    printf("DEBUG: Original size: %u\n", block_header.original_size);
-    
-    // Make sure this is the block we expected
-    if (block_header.block_id != block_id) {
-        fprintf(stderr, "Block ID mismatch: expected %u, got %u\n", block_id, block_header.block_id);
+    if (!verify_block_record(context, block_id, block_header, block_data)) {
         return -1;
     }
     
-    // Check output buffer size
-    if (output_size < block_header.original_size) {
-        fprintf(stderr, "Output buffer too small: need %u bytes, got %zu\n", 
-                block_header.original_size, output_size);
+    if (block_is_stored(block_header)) {
+        memcpy(output, block_data, block_header->original_size);
+        return (int64_t)block_header->original_size;
+    }
+    
+    // Decode straight from the record into the caller's buffer
+    size_t decompressed_size = output_size;
+    if (!decompress_buffer(block_header->codec, block_data, block_header->compressed_size,
+                           output, &decompressed_size)) {
+        fprintf(stderr, "Error decompressing block %u\n", block_id);
         return -1;
     }
     
-    // Read the compressed block data
-    size_t read_bytes = fread(context->block_buffer, 1, block_header.compressed_size, context->file);
-    if (read_bytes != block_header.compressed_size) {
-        fprintf(stderr, "Error reading block data: read %zu of %u bytes\n", 
-                read_bytes, block_header.compressed_size);
+    if (decompressed_size != block_header->original_size) {
+        fprintf(stderr, "Block %u decompressed to %zu bytes, expected %u\n",
+                block_id, decompressed_size, block_header->original_size);
         return -1;
     }
     
-    printf("DEBUG: Read %zu bytes of compressed data\n", read_bytes);
+    return (int64_t)decompressed_size;
+}
+
+// Take a scratch buffer set for one read, allocating one if all are in use
+// Concurrent readers each hold their own set, so the pool grows to the peak reader count
+static ReadScratch* acquire_scratch(ProgressiveContext* context) {
+    pthread_mutex_lock(&context->cache_lock);
+    ReadScratch* scratch = context->scratch;
+    if (scratch) {
+        context->scratch = scratch->next;
+    }
+    pthread_mutex_unlock(&context->cache_lock);
     
-    // Verify checksum if present
-    if (has_checksum) {
-        ChecksumData calculated;
-        calculate_checksum(context->block_buffer, block_header.compressed_size, &calculated, checksum_type);
-        if (!verify_checksum(context->block_buffer, block_header.compressed_size, &block_header.block_checksum)) {
-            fprintf(stderr, "Block checksum verification failed\n");
-            return -1;
+    if (scratch) {
+        return scratch;
+    }
+    
+    // Mapped contexts read records in place and need no record buffer
+    scratch = (ReadScratch*)calloc(1, sizeof(ReadScratch));
+    if (scratch && !context->map) {
+        scratch->record = (uint8_t*)malloc(get_block_header_size(&context->header) +
+                                           get_record_capacity(&context->header));
+    }
+    if (scratch) {
+        scratch->block = (uint8_t*)malloc(context->header.block_size);
+    }
+    if (!scratch || (!scratch->record && !context->map) || !scratch->block) {
+        fprintf(stderr, "Memory allocation error\n");
+        if (scratch) {
+            free(scratch->record);
+            free(scratch->block);
+            free(scratch);
+        }
+        return NULL;
+    }
+    return scratch;
+}
+
+// Return a scratch buffer set to the context
+static void release_scratch(ProgressiveContext* context, ReadScratch* scratch) {
+    pthread_mutex_lock(&context->cache_lock);
+    scratch->next = context->scratch;
+    context->scratch = scratch;
+    pthread_mutex_unlock(&context->cache_lock);
+}
+
+// Copy up to count bytes from offset within a cached block into output
+// Returns the decoded block size, or -1 if the block is not cached
+static int64_t cache_fetch(ProgressiveContext* context, uint32_t block_id, size_t offset, uint8_t* output, size_t count) {
+    BlockCache* cache = &context->cache;
+    int64_t size = -1;
+    
+    pthread_mutex_lock(&context->cache_lock);
+    BlockCacheEntry* entry = cache->max_entries ? cache_find(cache, block_id) : NULL;
+    if (entry) {
+        cache->hits++;
+        cache_unlink(cache, entry);
+        cache_push_front(cache, entry);
+        
+        // Copy while the lock keeps the entry from being reused
+        if (offset < entry->size) {
+            size_t available = entry->size - offset;
+            memcpy(output, entry->data + offset, count < available ? count : available);
+        }
+        size = (int64_t)entry->size;
+    } else if (cache->max_entries) {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&context->cache_lock);
+    
+    return size;
+}
+
+// Add a decoded block to the cache, evicting the least recently used entry if full
+static void cache_store(ProgressiveContext* context, uint32_t block_id, const uint8_t* data, size_t size) {
+    BlockCache* cache = &context->cache;
+    
+    pthread_mutex_lock(&context->cache_lock);
+    
+    // Another reader may have decoded the same block meanwhile
+    if (cache->max_entries == 0 || cache_find(cache, block_id)) {
+        pthread_mutex_unlock(&context->cache_lock);
+        return;
+    }
+    
+    BlockCacheEntry* entry;
+    if (cache->entry_count >= cache->max_entries) {
+        entry = cache_evict(cache);
+    } else {
+        entry = (BlockCacheEntry*)calloc(1, sizeof(BlockCacheEntry));
+        if (entry) {
+            entry->data = (uint8_t*)malloc(context->header.block_size);
+        }
+        if (!entry || !entry->data) {
+            // Caching is best effort, the block was already decoded
+            free(entry);
+            pthread_mutex_unlock(&context->cache_lock);
+            return;
         }
     }
     
-    // Decompress the block based on algorithm
-    size_t decompressed_size = 0;
+    memcpy(entry->data, data, size);
+    entry->block_id = block_id;
+    entry->size = size;
+    cache_push_front(cache, entry);
+    BlockCacheEntry** bucket = &cache->buckets[block_id & cache->bucket_mask];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    cache->entry_count++;
     
-    printf("DEBUG: Decompressing with algorithm: %d\n", context->header.algorithm);
+    pthread_mutex_unlock(&context->cache_lock);
+}
+
+// Read and decode a block into output using record as scratch, then cache it
+static int64_t decode_block(ProgressiveContext* context, uint32_t block_id, uint8_t* record,
+                            uint8_t* output, size_t output_size) {
+    BlockHeader block_header;
+    const uint8_t* source = read_block_record(context, block_id, record, &block_header);
+    if (!source) {
+        return -1;
+    }
     
-    // For testing and debugging, we'll just do a basic decompression
-    // In a real implementation, we would use the correct algorithm
+    int64_t result = decode_block_record(context, block_id, &block_header, source, output, output_size);
+    if (result >= 0) {
+        cache_store(context, block_id, output, (size_t)result);
+    }
+    return result;
+}
+
+// Decompress a specific block by ID
+int64_t progressive_decompress_block(ProgressiveContext* context, uint32_t block_id, uint8_t* output, size_t output_size) {
+    if (!context || !context->initialized || !output || block_id >= context->header.total_blocks) {
+        fprintf(stderr, "DEBUG: Invalid context or parameters\n");
+        return -1;
+    }
     
-    // Create a temporary decompression file
-    const char* temp_input = TEMP_INPUT_FILE;
+    int64_t size = cache_fetch(context, block_id, 0, output, output_size);
+    if (size >= 0) {
+        if (output_size < (size_t)size) {
+            fprintf(stderr, "Output buffer too small: need %lld bytes, got %zu\n", (long long)size, output_size);
+            return -1;
+        }
+        return size;
+    }
     
-    FILE* temp_in = fopen(temp_input, "wb");
-    if (!temp_in) {
-        fprintf(stderr, "Error creating temporary input file\n");
+    ReadScratch* scratch = acquire_scratch(context);
+    if (!scratch) {
         return -1;
     }
+    size = decode_block(context, block_id, scratch->record, output, output_size);
+    release_scratch(context, scratch);
     
-    // Write the compressed data to a temporary file
-    if (fwrite(context->block_buffer, 1, block_header.compressed_size, temp_in) != block_header.compressed_size) {
-        fprintf(stderr, "Error writing to temporary file\n");
-        fclose(temp_in);
+    return size;
+}
+
+// Get the decoded data of a block without copying it when possible
+int64_t progressive_get_block_view(ProgressiveContext* context, uint32_t block_id, uint8_t* buffer,
+                                   size_t buffer_size, const uint8_t** data) {
+    if (!context || !context->initialized || !data || block_id >= context->header.total_blocks) {
         return -1;
     }
-    fclose(temp_in);
+    *data = NULL;
     
-    printf("DEBUG: Using temp file method for decompression\n");
+    // Stored blocks in a mapping already are the decoded data
+    if (context->map) {
+        BlockHeader block_header;
+        const uint8_t* record = map_block_record(context, block_id, &block_header);
+        if (!record) {
+            return -1;
+        }
+        
+        if (block_is_stored(&block_header)) {
+            const uint8_t* block_data = record + get_block_header_size(&context->header);
+            if (!verify_block_record(context, block_id, &block_header, block_data)) {
+                return -1;
+            }
+            *data = block_data;
+            return (int64_t)block_header.original_size;
+        }
+    }
     
-    // For testing, we'll just copy the input file to the output
-    // This should show that the file handling works, even if the decompression is not correct
-    FILE* input = fopen(context->filename, "rb");
-    if (!input) {
-        fprintf(stderr, "Error opening original input file\n");
+    if (!buffer) {
         return -1;
     }
     
-    // Seek past the header to the content
-    fseek(input, 0, SEEK_SET);
-    char buffer[1024];
-    size_t bytes_read;
-    decompressed_size = 0;
+    int64_t size = progressive_decompress_block(context, block_id, buffer, buffer_size);
+    if (size >= 0) {
+        *data = buffer;
+    }
+    return size;
+}
+
+// Read length bytes of original data starting at offset into buffer
+// Only the blocks overlapping the range are decoded, and cached blocks not at all
+int64_t progressive_pread(ProgressiveContext* context, uint64_t offset, size_t length, uint8_t* buffer) {
+    if (!context || !context->initialized || (!buffer && length > 0)) {
+        return -1;
+    }
     
-    // Read the original file and copy to the output
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), input)) > 0) {
-        size_t copy_size = bytes_read;
+    uint64_t original_size = context->header.original_size;
+    if (offset >= original_size || length == 0) {
+        return 0;
+    }
+    if (length > original_size - offset) {
+        length = (size_t)(original_size - offset);
+    }
+    
+    uint32_t block_size = context->header.block_size;
+    size_t copied = 0;
+    
+    while (copied < length) {
+        uint64_t position = offset + copied;
+        uint32_t block_id = (uint32_t)(position / block_size);
+        size_t block_offset = (size_t)(position % block_size);
+        size_t wanted = length - copied;
         
-        // Make sure we don't exceed the original block size
-        if (decompressed_size + copy_size > block_header.original_size) {
-            copy_size = block_header.original_size - decompressed_size;
+        if (block_id >= context->header.total_blocks) {
+            fprintf(stderr, "Offset %llu lies beyond the last block\n", (unsigned long long)position);
+            return -1;
         }
         
-        if (copy_size > 0) {
-            memcpy(output + decompressed_size, buffer, copy_size);
-            decompressed_size += copy_size;
+        // Every block but the last holds exactly block_size bytes
+        size_t expected = block_size;
+        if (block_id == context->header.total_blocks - 1) {
+            expected = (size_t)(original_size - (uint64_t)block_id * block_size);
+        }
+        size_t available = expected - block_offset;
+        size_t count = wanted < available ? wanted : available;
+        
+        int64_t decoded = cache_fetch(context, block_id, block_offset, buffer + copied, count);
+        if (decoded < 0) {
+            ReadScratch* scratch = acquire_scratch(context);
+            if (!scratch) {
+                return -1;
+            }
+            
+            if (block_offset == 0 && count == expected) {
+                // Blocks wholly inside the range need no intermediate copy
+                decoded = decode_block(context, block_id, scratch->record, buffer + copied, count);
+            } else {
+                decoded = decode_block(context, block_id, scratch->record, scratch->block, block_size);
+                if (decoded == (int64_t)expected) {
+                    memcpy(buffer + copied, scratch->block + block_offset, count);
+                }
+            }
+            release_scratch(context, scratch);
+            
+            if (decoded < 0) {
+                return -1;
+            }
         }
         
-        if (decompressed_size >= block_header.original_size) {
+        if ((size_t)decoded != expected) {
+            fprintf(stderr, "Block %u holds %lld bytes, expected %zu\n", block_id, (long long)decoded, expected);
+            return -1;
+        }
+        copied += count;
+    }
+    
+    return (int64_t)copied;
+}
+
+// Block queued for decoding on the worker pool
+typedef struct {
+    const ProgressiveContext* context; // Source file description
+    uint32_t block_id;          // Block being decoded
+    BlockHeader header;         // Parsed block header
+    uint8_t* record;            // Buffer for the block record (unused when mapped)
+    const uint8_t* source;      // Block header and compressed data
+    uint8_t* output;            // Decoded block
+    size_t output_capacity;     // Size of output
+    int64_t output_size;        // Decoded size, -1 on error
+    int compute_crc;            // Whether to checksum the decoded block
+    uint32_t crc;               // CRC32 of the decoded block (if compute_crc)
+    ParallelTask task;          // Pool task decoding this block
+} BlockDecodeJob;
+
+// Pool task: verify and decode one block record
+static void decode_block_task(void* arg) {
+    BlockDecodeJob* job = (BlockDecodeJob*)arg;
+    job->output_size = decode_block_record(job->context, job->block_id, &job->header, job->source,
+                                           job->output, job->output_capacity);
+    if (job->compute_crc && job->output_size >= 0) {
+        job->crc = crc32_compute(job->output, (size_t)job->output_size);
+    }
+}
+
+// Decode blocks start_block..end_block on the worker pool and hand them to callback in order
+// This thread reads records ahead into a bounded ring of slots while workers decode them,
+// keeping up to prefetch_depth blocks in flight past the one the callback is processing
+// (0 sizes the ring from the thread count).
+// If crc is not NULL, workers also checksum each block and *crc is extended with the CRC32
+// of every block passed to the callback.
+// Returns 1 on success or when the callback stops early, 0 on error
+static int decompress_blocks_parallel(ProgressiveContext* context, uint32_t start_block, uint32_t end_block,
+                                      uint32_t prefetch_depth, StreamCallback callback, void* user_data,
+                                      uint32_t* crc) {
+    uint32_t block_count = end_block - start_block + 1;
+    size_t record_capacity = get_block_header_size(&context->header) +
+                             get_record_capacity(&context->header);
+    
+    int thread_count = get_thread_count();
+    if (thread_count <= 0) {
+        thread_count = get_optimal_threads();
+    }
+    if (thread_count <= 0) {
+        thread_count = 1;
+    }
+    uint32_t slot_count = (uint32_t)thread_count * PARALLEL_RING_SLOTS_PER_THREAD;
+    if (prefetch_depth > 0) {
+        slot_count = prefetch_depth < MAX_PREFETCH_DEPTH ? prefetch_depth + 1 : MAX_PREFETCH_DEPTH + 1;
+    }
+    if (slot_count > block_count) {
+        slot_count = block_count;
+    }
+    
+    BlockDecodeJob* jobs = (BlockDecodeJob*)calloc(slot_count, sizeof(BlockDecodeJob));
+    int success = (jobs != NULL);
+    
+    for (uint32_t i = 0; success && i < slot_count; i++) {
+        jobs[i].context = context;
+        jobs[i].compute_crc = (crc != NULL);
+        if (!context->map) {
+            jobs[i].record = (uint8_t*)malloc(record_capacity);
+        }
+        jobs[i].output_capacity = context->header.block_size;
+        jobs[i].output = (uint8_t*)malloc(jobs[i].output_capacity);
+        success = ((jobs[i].record || context->map) && jobs[i].output);
+    }
+    
+    if (!success) {
+        fprintf(stderr, "Memory allocation error\n");
+    }
+    
+    uint32_t submitted = 0;
+    uint32_t done = 0;
+    int stopped = 0;
+    
+    for (; success && !stopped && done < block_count; done++) {
+        // Reader stage: load records into free slots and queue them for decoding
+        while (success && submitted < block_count && submitted < done + slot_count) {
+            BlockDecodeJob* job = &jobs[submitted % slot_count];
+            job->block_id = start_block + submitted;
+            
+            job->source = read_block_record(context, job->block_id, job->record, &job->header);
+            if (!job->source) {
+                success = 0;
+                break;
+            }
+            
+            parallel_submit(&job->task, decode_block_task, job);
+            submitted++;
+        }
+        
+        if (done >= submitted) {
+            break;
+        }
+        
+        // Writer stage: hand decoded blocks to the callback in order
+        BlockDecodeJob* job = &jobs[done % slot_count];
+        parallel_wait(&job->task);
+        
+        if (!success) {
+            break;
+        }
+        if (job->output_size < 0) {
+            fprintf(stderr, "Error decompressing block %u\n", job->block_id);
+            success = 0;
             break;
         }
+        
+        if (crc) {
+            *crc = crc32_combine(*crc, job->crc, (uint64_t)job->output_size);
+        }
+        if (callback(job->output, (size_t)job->output_size, user_data) != 0) {
+            // Callback indicated to stop processing
+            stopped = 1;
+        }
     }
     
-    fclose(input);
-    printf("DEBUG: Copied %zu bytes from original file for testing\n", decompressed_size);
+    // Let any queued blocks finish before their buffers are released
+    for (uint32_t i = done; i < submitted; i++) {
+        parallel_wait(&jobs[i % slot_count].task);
+    }
     
-    // Update position and last block ID
-    context->current_pos = ftell(context->file);
-    context->last_block_id = block_id;
+    for (uint32_t i = 0; jobs && i < slot_count; i++) {
+        free(jobs[i].record);
+        free(jobs[i].output);
+    }
+    free(jobs);
     
-    return (int64_t)decompressed_size;
+    return success;
+}
+
+// Stream callback appending decoded blocks to a FILE
+static int write_blocks_to_file(const uint8_t* data, size_t size, void* user_data) {
+    FILE* output = (FILE*)user_data;
+    if (fwrite(data, 1, size, output) != size) {
+        fprintf(stderr, "Error writing to output file\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Output file and running checksum of a full decompression
+typedef struct {
+    FILE* output;
+    ChecksumContext* checksum;  // Streamed file checksum (NULL for CRC32, which the workers compute)
+} DecompressOutput;
+
+// Stream callback writing decoded blocks to a file and checksumming them
+static int write_and_checksum_blocks(const uint8_t* data, size_t size, void* user_data) {
+    DecompressOutput* out = (DecompressOutput*)user_data;
+    if (out->checksum && !checksum_update(out->checksum, data, size)) {
+        fprintf(stderr, "Error updating file checksum\n");
+        return 1;
+    }
+    return write_blocks_to_file(data, size, out->output);
 }
 
 // Get header information without decompressing
@@ -731,14 +1389,118 @@ uint64_t progressive_get_original_size(ProgressiveContext* context) {
     return context ? context->header.original_size : 0;
 }
 
+// Block queued for compression on the worker pool
+typedef struct {
+    uint8_t* input;             // Block data
+    size_t input_size;          // Bytes in the block
+    uint8_t* output;            // Compressed block
+    size_t output_size;         // Capacity on entry, compressed size on return
+    uint8_t* sample;            // Sample gathered for codec selection (CODEC_SAMPLE_SIZE bytes)
+    uint8_t* trial;             // Output of trial compressions
+    size_t trial_capacity;      // Size of trial
+    uint8_t codec;              // Codec chosen for the block
+    ChecksumType checksum_type; // Block checksum to compute (CHECKSUM_NONE for none)
+    ChecksumData checksum;      // Checksum of the block data as written
+    uint32_t input_crc;         // CRC32 of the block's original data (CRC32 checksums only)
+    int success;                // Result of compress_buffer
+    ParallelTask task;          // Pool task compressing this block
+} BlockCompressJob;
+
+// Pick the codec for a block from a sample of it
+// Near-random samples are stored and single runs go to RLE without trying anything;
+// otherwise every block codec is tried on the sample and the smallest output wins.
+static uint8_t choose_block_codec(BlockCompressJob* job) {
+    const uint8_t* sample = job->input;
+    size_t sample_size = job->input_size;
+    
+    // Gather evenly spaced slices of large blocks into one sample
+    if (sample_size > CODEC_SAMPLE_SIZE) {
+        size_t slice = CODEC_SAMPLE_SIZE / CODEC_SAMPLE_SLICES;
+        size_t stride = (job->input_size - slice) / (CODEC_SAMPLE_SLICES - 1);
+        for (size_t i = 0; i < CODEC_SAMPLE_SLICES; i++) {
+            memcpy(job->sample + i * slice, job->input + i * stride, slice);
+        }
+        sample = job->sample;
+        sample_size = slice * CODEC_SAMPLE_SLICES;
+    }
+    
+    // Byte histogram and repeated-byte count of the sample
+    size_t counts[256] = {0};
+    size_t repeats = 0;
+    counts[sample[0]]++;
+    for (size_t i = 1; i < sample_size; i++) {
+        counts[sample[i]]++;
+        repeats += (sample[i] == sample[i - 1]);
+    }
+    
+    if (repeats >= (size_t)(CODEC_RLE_RUN_FRACTION * (double)sample_size)) {
+        return RLE;
+    }
+    
+    double entropy = 0.0;
+    for (int i = 0; i < 256; i++) {
+        if (counts[i]) {
+            double p = (double)counts[i] / (double)sample_size;
+            entropy -= p * log2(p);
+        }
+    }
+    if (entropy >= CODEC_STORED_ENTROPY) {
+        return BLOCK_CODEC_STORED;
+    }
+    
+    uint8_t best_codec = BLOCK_CODEC_STORED;
+    size_t best_size = sample_size;
+    for (size_t i = 0; i < BLOCK_CODEC_COUNT; i++) {
+        size_t trial_size = job->trial_capacity;
+        if (compress_buffer(block_codecs[i], sample, sample_size, job->trial, &trial_size) &&
+            trial_size < best_size) {
+            best_codec = block_codecs[i];
+            best_size = trial_size;
+        }
+    }
+    return best_codec;
+}
+
+// Pool task: pick a codec for one block, compress it and checksum the result
+static void compress_block_task(void* arg) {
+    BlockCompressJob* job = (BlockCompressJob*)arg;
+    
+    job->codec = choose_block_codec(job);
+    job->success = 1;
+    if (job->codec != BLOCK_CODEC_STORED) {
+        job->success = compress_buffer(job->codec, job->input, job->input_size,
+                                       job->output, &job->output_size);
+        
+        // Keep blocks that would not shrink as they are
+        if (job->success && job->output_size >= job->input_size) {
+            job->codec = BLOCK_CODEC_STORED;
+        }
+    }
+    if (job->codec == BLOCK_CODEC_STORED) {
+        job->output_size = job->input_size;
+    }
+    
+    if (job->success && job->checksum_type != CHECKSUM_NONE) {
+        calculate_checksum(job->codec == BLOCK_CODEC_STORED ? job->input : job->output, job->output_size,
+                           &job->checksum, job->checksum_type);
+    }
+    
+    // CRC32 file checksums are merged from per-block CRCs by the writer
+    if (job->success && job->checksum_type == CHECKSUM_CRC32) {
+        job->input_crc = crc32_compute(job->input, job->input_size);
+    }
+}
+
 // Compress a file using progressive format
+// Blocks are independent, so they are compressed on the worker pool while this thread
+// reads ahead into a ring of block slots and writes finished blocks in order
 int progressive_compress_file(const char* input_file, const char* output_file, ChecksumType checksum_type) {
     if (!input_file || !output_file) {
         fprintf(stderr, "Error: Invalid input or output file for progressive compression\n");
         return 0;
     }
     
-    // Use default algorithm (Huffman) and block size
+    // Huffman is recorded as the file default; each block picks its own codec
     CompressionType algorithm = HUFFMAN;
     size_t block_size = DEFAULT_BLOCK_SIZE;
     
@@ -756,15 +1518,15 @@ int progressive_compress_file(const char* input_file, const char* output_file, C
     }
     
     // Get file size
-    fseek(input, 0, SEEK_END);
-    uint64_t file_size = ftell(input);
-    fseek(input, 0, SEEK_SET);
+    fseeko(input, 0, SEEK_END);
+    uint64_t file_size = (uint64_t)ftello(input);
+    fseeko(input, 0, SEEK_SET);
     
     // Initialize header
     ProgressiveHeader header;
     memset(&header, 0, sizeof(header));
     memcpy(header.magic, "PROG", 4);
-    header.version = 1;
+    header.version = CURRENT_VERSION;
     header.algorithm = (uint8_t)algorithm;
     header.flags = 0;
     if (checksum_type != CHECKSUM_NONE) {
@@ -775,207 +1537,268 @@ int progressive_compress_file(const char* input_file, const char* output_file, C
     header.original_size = file_size;
     header.checksum.type = checksum_type;
     
-    // Write header (we'll update it later with correct checksum)
-    if (fwrite(&header, sizeof(header), 1, output) != 1) {
+    // Write header (we'll update it later with the checksum and index location)
+    if (!write_header(output, &header)) {
         fprintf(stderr, "Error: Failed to write progressive header\n");
         fclose(input);
         fclose(output);
         return 0;
     }
     
-    // Allocate buffers
-    uint8_t* input_buffer = (uint8_t*)malloc(block_size);
-    uint8_t* compressed_buffer = (uint8_t*)malloc(block_size * 2); // Compressed data might be larger
+    // Size the ring of block slots from the thread count
+    int thread_count = get_thread_count();
+    if (thread_count <= 0) {
+        thread_count = get_optimal_threads();
+    }
+    if (thread_count <= 0) {
+        thread_count = 1;
+    }
+    uint32_t slot_count = (uint32_t)thread_count * PARALLEL_RING_SLOTS_PER_THREAD;
+    if (slot_count > header.total_blocks) {
+        slot_count = header.total_blocks ? header.total_blocks : 1;
+    }
     
-    if (!input_buffer || !compressed_buffer) {
+    // Allocate buffers (blocks may use any block codec)
+    size_t compressed_capacity = get_record_capacity(&header);
+    size_t trial_capacity = 0;
+    for (size_t i = 0; i < BLOCK_CODEC_COUNT; i++) {
+        size_t bound = compress_bound(block_codecs[i], CODEC_SAMPLE_SIZE);
+        if (bound > trial_capacity) {
+            trial_capacity = bound;
+        }
+    }
+    BlockCompressJob* jobs = (BlockCompressJob*)calloc(slot_count, sizeof(BlockCompressJob));
+    BlockIndexEntry* block_index = (BlockIndexEntry*)malloc((header.total_blocks ? header.total_blocks : 1) * sizeof(BlockIndexEntry));
+    int success = (jobs && block_index);
+    
+    for (uint32_t i = 0; success && i < slot_count; i++) {
+        jobs[i].input = (uint8_t*)malloc(block_size);
+        jobs[i].output = (uint8_t*)malloc(compressed_capacity);
+        jobs[i].sample = (uint8_t*)malloc(CODEC_SAMPLE_SIZE);
+        jobs[i].trial_capacity = trial_capacity;
+        jobs[i].trial = (uint8_t*)malloc(trial_capacity);
+        jobs[i].checksum_type = checksum_type;
+        success = (jobs[i].input && jobs[i].output && jobs[i].sample && jobs[i].trial);
+    }
+    
+    if (!success) {
         fprintf(stderr, "Error: Memory allocation failed for compression buffers\n");
-        if (input_buffer) free(input_buffer);
-        if (compressed_buffer) free(compressed_buffer);
-        fclose(input);
-        fclose(output);
-        return 0;
     }
     
-    // Process file in blocks
-    ChecksumData file_checksum;
-    memset(&file_checksum, 0, sizeof(file_checksum));
-    file_checksum.type = checksum_type;
+    // The file checksum is computed in one pass as blocks are read, except CRC32, which
+    // workers compute per block for the writer to combine
+    ChecksumContext file_checksum;
+    uint32_t file_crc = 0;
+    if (!checksum_init(&file_checksum, checksum_type)) {
+        fprintf(stderr, "Error: Failed to initialize file checksum\n");
+        success = 0;
+    }
     
+    uint32_t submitted = 0;
     uint32_t block_id = 0;
-    size_t total_bytes_processed = 0;
     
-    while (total_bytes_processed < file_size) {
-        // Read a block of data
-        size_t bytes_to_read = (file_size - total_bytes_processed < block_size) ? 
-                               (file_size - total_bytes_processed) : block_size;
-        
-        size_t bytes_read = fread(input_buffer, 1, bytes_to_read, input);
-        if (bytes_read != bytes_to_read) {
-            fprintf(stderr, "Error: Failed to read from input file\n");
-            free(input_buffer);
-            free(compressed_buffer);
-            fclose(input);
-            fclose(output);
-            return 0;
+    for (; success && block_id < header.total_blocks; block_id++) {
+        // Reader stage: fill free slots and queue them for compression
+        while (success && submitted < header.total_blocks && submitted < block_id + slot_count) {
+            BlockCompressJob* job = &jobs[submitted % slot_count];
+            uint64_t offset = (uint64_t)submitted * block_size;
+            size_t bytes_to_read = (file_size - offset < block_size) ? (size_t)(file_size - offset) : block_size;
+            
+            if (fread(job->input, 1, bytes_to_read, input) != bytes_to_read) {
+                fprintf(stderr, "Error: Failed to read from input file\n");
+                success = 0;
+                break;
+            }
+            
+            // Update file checksum
+            if (checksum_type != CHECKSUM_CRC32 && !checksum_update(&file_checksum, job->input, bytes_to_read)) {
+                fprintf(stderr, "Error: Failed to update file checksum\n");
+                success = 0;
+                break;
+            }
+            
+            job->input_size = bytes_to_read;
+            job->output_size = compressed_capacity;
+            parallel_submit(&job->task, compress_block_task, job);
+            submitted++;
         }
         
-        // Update file checksum
-        if (checksum_type != CHECKSUM_NONE) {
-            calculate_checksum(input_buffer, bytes_read, &file_checksum, checksum_type);
+        if (block_id >= submitted) {
+            break;
         }
         
-        // Compress the block
-        size_t compressed_size = block_size * 2;
-        int compress_result = compress_buffer((int)algorithm, input_buffer, bytes_read, 
-                                             compressed_buffer, &compressed_size);
+        // Writer stage: wait for the next block in order
+        BlockCompressJob* job = &jobs[block_id % slot_count];
+        parallel_wait(&job->task);
         
-        if (!compress_result) {
+        if (!success) {
+            break;
+        }
+        if (!job->success) {
             fprintf(stderr, "Error: Compression failed for block %u\n", block_id);
-            free(input_buffer);
-            free(compressed_buffer);
-            fclose(input);
-            fclose(output);
-            return 0;
+            success = 0;
+            break;
         }
         
         // Initialize block header
         BlockHeader block_header;
         memset(&block_header, 0, sizeof(block_header));
         block_header.block_id = block_id;
-        block_header.compressed_size = (uint32_t)compressed_size;
-        block_header.original_size = (uint32_t)bytes_read;
-        
-        // Calculate block checksum if needed
+        block_header.compressed_size = (uint32_t)job->output_size;
+        block_header.original_size = (uint32_t)job->input_size;
+        block_header.codec = job->codec;
         if (checksum_type != CHECKSUM_NONE) {
-            calculate_checksum(compressed_buffer, compressed_size, &block_header.block_checksum, checksum_type);
+            block_header.block_checksum = job->checksum;
         }
         
-        // Write block header
-        if (fwrite(&block_header, sizeof(block_header), 1, output) != 1) {
-            fprintf(stderr, "Error: Failed to write block header\n");
-            free(input_buffer);
-            free(compressed_buffer);
-            fclose(input);
-            fclose(output);
-            return 0;
-        }
+        // Record the block location for the index footer
+        block_index[block_id].offset = (uint64_t)ftello(output);
+        block_index[block_id].compressed_size = block_header.compressed_size;
+        block_index[block_id].original_size = block_header.original_size;
         
-        // Write compressed data
-        if (fwrite(compressed_buffer, 1, compressed_size, output) != compressed_size) {
-            fprintf(stderr, "Error: Failed to write compressed data\n");
-            free(input_buffer);
-            free(compressed_buffer);
-            fclose(input);
-            fclose(output);
-            return 0;
+        // Write block header and block data
+        const uint8_t* block_data = job->codec == BLOCK_CODEC_STORED ? job->input : job->output;
+        if (!write_block_header(output, &block_header) ||
+            fwrite(block_data, 1, job->output_size, output) != job->output_size) {
+            fprintf(stderr, "Error: Failed to write compressed block %u\n", block_id);
+            success = 0;
+            break;
         }
-        
-        total_bytes_processed += bytes_read;
-        block_id++;
+        file_crc = crc32_combine(file_crc, job->input_crc, job->input_size);
     }
     
-    // Update header with file checksum
-    header.checksum = file_checksum;
-    fseek(output, 0, SEEK_SET);
-    if (fwrite(&header, sizeof(header), 1, output) != 1) {
-        fprintf(stderr, "Error: Failed to update progressive header with checksum\n");
-        free(input_buffer);
-        free(compressed_buffer);
-        fclose(input);
-        fclose(output);
-        return 0;
+    // Let any queued blocks finish before their buffers are released
+    for (uint32_t i = block_id; i < submitted; i++) {
+        parallel_wait(&jobs[i % slot_count].task);
+    }
+    
+    if (success) {
+        // Write the block index footer
+        header.index_offset = (uint64_t)ftello(output);
+        for (uint32_t i = 0; success && i < header.total_blocks; i++) {
+            if (fwrite(&block_index[i].offset, sizeof(uint64_t), 1, output) != 1 ||
+                fwrite(&block_index[i].compressed_size, sizeof(uint32_t), 1, output) != 1 ||
+                fwrite(&block_index[i].original_size, sizeof(uint32_t), 1, output) != 1) {
+                fprintf(stderr, "Error: Failed to write block index\n");
+                success = 0;
+            }
+        }
+    }
+    
+    if (success && !checksum_final(&file_checksum, &header.checksum)) {
+        fprintf(stderr, "Error: Failed to finalize file checksum\n");
+        success = 0;
+    }
+    if (checksum_type == CHECKSUM_CRC32) {
+        header.checksum.crc32 = file_crc;
+    }
+    
+    if (success) {
+        // Update header with file checksum and index location
+        fseeko(output, 0, SEEK_SET);
+        if (!write_header(output, &header)) {
+            fprintf(stderr, "Error: Failed to update progressive header\n");
+            success = 0;
+        }
     }
     
     // Clean up
-    free(input_buffer);
-    free(compressed_buffer);
+    checksum_context_free(&file_checksum);
+    for (uint32_t i = 0; jobs && i < slot_count; i++) {
+        free(jobs[i].input);
+        free(jobs[i].output);
+        free(jobs[i].sample);
+        free(jobs[i].trial);
+    }
+    free(jobs);
+    free(block_index);
     fclose(input);
-    fclose(output);
+    if (fclose(output) != 0) {
+        success = 0;
+    }
+    
+    if (!success) {
+        remove(output_file);
+        return 0;
+    }
     
     printf("Progressive compression complete: %llu bytes in %u blocks\n", 
-           (unsigned long long)file_size, block_id);
+           (unsigned long long)file_size, header.total_blocks);
     
     return 1;
 }
 
 // Decompress a progressive file completely
 int progressive_decompress_file(const char* input_file, const char* output_file) {
-    printf("DEBUG: Starting progressive decompression\n");
-    printf("DEBUG: Input file: %s\n", input_file);
-    printf("DEBUG: Output file: %s\n", output_file);
-    
-    // For testing purposes, let's extract the content directly
-    // Open the original text file (without .prog extension)
-    size_t len = strlen(input_file);
-    const char* extension = ".prog";
-    size_t ext_len = strlen(extension);
-    
-    // Extract the original filename by removing the .prog extension
-    if (len > ext_len && strcmp(input_file + len - ext_len, extension) == 0) {
-        char original_filename[MAX_PATH_LENGTH];
-        
-        // Use a safer approach than strncpy
-        size_t copy_len = len - ext_len;
-        if (copy_len > MAX_PATH_LENGTH - 1) {
-            copy_len = MAX_PATH_LENGTH - 1;
-        }
-        memcpy(original_filename, input_file, copy_len);
-        original_filename[copy_len] = '\0';
-        
-        printf("DEBUG: Original filename: %s\n", original_filename);
-        
-        // Open the original file for reading
-        FILE* original = fopen(original_filename, "rb");
-        if (!original) {
-            fprintf(stderr, "Error opening original file: %s\n", original_filename);
-            perror("File open error");
-            return 0;
-        }
-        
-        // Open output file for writing
-        FILE* output = fopen(output_file, "wb");
-        if (!output) {
-            fprintf(stderr, "Error creating output file: %s (errno: %d)\n", output_file, errno);
-            perror("File open error");
-            fclose(original);
-            return 0;
+    ProgressiveContext* context = progressive_init_mapped(input_file, PROGRESSIVE_ACCESS_SEQUENTIAL);
+    if (!context) {
+        return 0;
+    }
+    
+    FILE* output = fopen(output_file, "wb");
+    if (!output) {
+        fprintf(stderr, "Error creating output file: %s (errno: %d)\n", output_file, errno);
+        progressive_free(context);
+        return 0;
+    }
+    
+    // The whole-file checksum is only meaningful from version 5 on. CRC32 is computed per
+    // block by the decoding workers and combined; other checksums stream through the writer
+    int verify = (context->header.flags & FLAG_HAS_CHECKSUM) && context->header.version >= 5;
+    ChecksumType checksum_type = verify ? context->header.checksum.type : CHECKSUM_NONE;
+    ChecksumContext checksum;
+    uint32_t file_crc = 0;
+    DecompressOutput out = { output, NULL };
+    int success = checksum_init(&checksum, checksum_type);
+    if (checksum_type != CHECKSUM_CRC32) {
+        out.checksum = &checksum;
+    }
+    
+    // Decompress every block in order
+    if (success && context->header.total_blocks > 0) {
+        success = decompress_blocks_parallel(context, 0, context->header.total_blocks - 1, 0,
+                                             write_and_checksum_blocks, &out,
+                                             checksum_type == CHECKSUM_CRC32 ? &file_crc : NULL);
+    }
+    
+    if (ferror(output)) {
+        success = 0;
+    }
+    if (success && ftello(output) != (off_t)context->header.original_size) {
+        fprintf(stderr, "Decompressed %lld bytes, expected %llu\n",
+                (long long)ftello(output), (unsigned long long)context->header.original_size);
+        success = 0;
+    }
+    
+    if (success && verify) {
+        ChecksumData computed;
+        success = checksum_final(&checksum, &computed);
+        if (checksum_type == CHECKSUM_CRC32) {
+            computed.crc32 = file_crc;
         }
-        
-        printf("DEBUG: Files opened successfully\n");
-        
-        // Copy the content
-        char buffer[1024];
-        size_t bytes_read;
-        size_t total = 0;
-        
-        while ((bytes_read = fread(buffer, 1, sizeof(buffer), original)) > 0) {
-            size_t bytes_written = fwrite(buffer, 1, bytes_read, output);
-            if (bytes_written != bytes_read) {
-                fprintf(stderr, "Error writing to output file\n");
-                perror("Write error");
-                fclose(original);
-                fclose(output);
-                return 0;
-            }
-            total += bytes_written;
+        if (!success || !checksum_equal(&computed, &context->header.checksum)) {
+            fprintf(stderr, "File checksum verification failed\n");
+            success = 0;
         }
-        
-        printf("DEBUG: Copied %zu bytes from original file\n", total);
-        
-        fclose(original);
-        fclose(output);
-        return 1;
     }
+    checksum_context_free(&checksum);
     
-    fprintf(stderr, "Input file doesn't have .prog extension\n");
-    return 0;
+    if (fclose(output) != 0) {
+        success = 0;
+    }
+    progressive_free(context);
+    
+    if (!success) {
+        remove(output_file);
+    }
+    return success;
 }
 
 // Decompress a range of blocks
 int progressive_decompress_range(const char* input_file, const char* output_file, 
                                uint32_t start_block, uint32_t end_block) {
     // Initialize progressive context
-    ProgressiveContext* context = progressive_init(input_file);
+    ProgressiveContext* context = progressive_init_mapped(input_file, PROGRESSIVE_ACCESS_SEQUENTIAL);
     if (!context) {
         return 0;
     }
@@ -996,85 +1819,110 @@ int progressive_decompress_range(const char* input_file, const char* output_file
         return 0;
     }
     
-    // Allocate output buffer for a block
-    uint8_t* buffer = (uint8_t*)malloc(context->header.block_size * 2);
-    if (!buffer) {
-        fprintf(stderr, "Memory allocation error\n");
-        fclose(output);
+    // Decompress the specified block range
+    int success = decompress_blocks_parallel(context, start_block, end_block, 0, write_blocks_to_file, output, NULL);
+    if (ferror(output)) {
+        success = 0;
+    }
+    
+    // Clean up
+    if (fclose(output) != 0) {
+        success = 0;
+    }
+    progressive_free(context);
+    
+    return success;
+}
+
+// Extract length bytes of original data starting at offset into a file
+int progressive_extract_bytes(const char* input_file, const char* output_file, uint64_t offset, uint64_t length) {
+    ProgressiveContext* context = progressive_init_mapped(input_file, PROGRESSIVE_ACCESS_SEQUENTIAL);
+    if (!context) {
+        return 0;
+    }
+    
+    if (offset > context->header.original_size) {
+        fprintf(stderr, "Offset %llu is past the end of the data (%llu bytes)\n",
+                (unsigned long long)offset, (unsigned long long)context->header.original_size);
         progressive_free(context);
         return 0;
     }
     
-    // Decompress the specified block range
-    int success = 1;
-    for (uint32_t block_id = start_block; block_id <= end_block; block_id++) {
-        // Decompress the block
-        int64_t decompressed_size = progressive_decompress_block(context, block_id, buffer, 
-                                                               context->header.block_size * 2);
-        if (decompressed_size < 0) {
-            fprintf(stderr, "Error decompressing block %u\n", block_id);
-            success = 0;
-            break;
-        }
-        
-        // Write to output file
-        if (fwrite(buffer, 1, decompressed_size, output) != (size_t)decompressed_size) {
-            fprintf(stderr, "Error writing to output file\n");
+    FILE* output = fopen(output_file, "wb");
+    if (!output) {
+        fprintf(stderr, "Error creating output file: %s\n", output_file);
+        progressive_free(context);
+        return 0;
+    }
+    
+    // Each block is read once here, so caching would only add copies
+    progressive_set_cache_size(context, 0);
+    
+    // Copy out one block's worth at a time so memory stays bounded
+    size_t piece_size = context->header.block_size;
+    uint8_t* buffer = (uint8_t*)malloc(piece_size);
+    int success = (buffer != NULL);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation error\n");
+    }
+    
+    uint64_t position = offset;
+    uint64_t end = offset + length;
+    if (end < offset || end > context->header.original_size) {
+        end = context->header.original_size;
+    }
+    
+    while (success && position < end) {
+        size_t wanted = (end - position) < piece_size ? (size_t)(end - position) : piece_size;
+        int64_t read_bytes = progressive_pread(context, position, wanted, buffer);
+        if (read_bytes <= 0 || fwrite(buffer, 1, (size_t)read_bytes, output) != (size_t)read_bytes) {
+            fprintf(stderr, "Error extracting bytes at offset %llu\n", (unsigned long long)position);
             success = 0;
             break;
         }
+        position += (uint64_t)read_bytes;
     }
     
-    // Clean up
+    if (fclose(output) != 0) {
+        success = 0;
+    }
     free(buffer);
-    fclose(output);
     progressive_free(context);
     
+    if (!success) {
+        remove(output_file);
+    }
     return success;
 }
 
 // Process a progressive file through streaming
 int progressive_stream_process(const char* input_file, StreamCallback callback, void* user_data) {
+    return progressive_stream_process_prefetch(input_file, callback, user_data, 0);
+}
+
+// Process a progressive file through streaming, decoding up to prefetch_depth blocks ahead
+int progressive_stream_process_prefetch(const char* input_file, StreamCallback callback, void* user_data,
+                                        uint32_t prefetch_depth) {
     if (!input_file || !callback) {
         return 0;
     }
     
     // Initialize progressive context
-    ProgressiveContext* context = progressive_init(input_file);
+    ProgressiveContext* context = progressive_init_mapped(input_file, PROGRESSIVE_ACCESS_SEQUENTIAL);
     if (!context) {
         return 0;
     }
     
-    // Allocate output buffer for a block
-    uint8_t* buffer = (uint8_t*)malloc(context->header.block_size * 2);
-    if (!buffer) {
-        fprintf(stderr, "Memory allocation error\n");
-        progressive_free(context);
-        return 0;
-    }
+    // Each block is read once here, so caching would only add copies
+    progressive_set_cache_size(context, 0);
     
-    // Process each block and call the callback
+    // Workers decode the next blocks while the callback processes the current one
     int success = 1;
-    for (uint32_t block_id = 0; block_id < context->header.total_blocks; block_id++) {
-        // Decompress the block
-        int64_t decompressed_size = progressive_decompress_block(context, block_id, buffer, 
-                                                               context->header.block_size * 2);
-        if (decompressed_size < 0) {
-            fprintf(stderr, "Error decompressing block %u\n", block_id);
-            success = 0;
-            break;
-        }
-        
-        // Call the callback with the decompressed data
-        if (callback(buffer, decompressed_size, user_data) != 0) {
-            // Callback indicated to stop processing
-            break;
-        }
+    if (context->header.total_blocks > 0) {
+        success = decompress_blocks_parallel(context, 0, context->header.total_blocks - 1,
+                                             prefetch_depth, callback, user_data, NULL);
     }
     
-    // Clean up
-    free(buffer);
     progressive_free(context);
-    
     return success;
-} 
\ No newline at end of file
+}
@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "large_file_utils.h"
 #include "compression.h"
 
@@ -15,28 +16,47 @@
 // Maximum block size (16MB)
 #define MAX_BLOCK_SIZE (16 * 1024 * 1024)
 
+// Upper bound on blocks decoded ahead of a stream consumer
+#define MAX_PREFETCH_DEPTH 64
+
+// Default memory budget for the decoded block cache (8 default-sized blocks)
+#define DEFAULT_BLOCK_CACHE_SIZE (8 * DEFAULT_BLOCK_SIZE)
+
 // Magic number for progressive files
 #define MAGIC_NUMBER "PROG"
 // Current version of the progressive format
-#define CURRENT_VERSION 1
+// Version 2 adds the block index footer
+// Version 3 stores blocks that would not shrink uncompressed (compressed size == original size)
+// Version 4 gives every block its own codec
+// Version 5 checksums the whole original data in the file header and uses real MD5/SHA256 digests
+#define CURRENT_VERSION 5
+
+// Block codec for data stored uncompressed (other codecs are algorithm indices)
+#define BLOCK_CODEC_STORED 0xFF
+
+// Bytes of a block sampled when choosing its codec, gathered from evenly spaced slices
+#define CODEC_SAMPLE_SIZE (64 * 1024)
+#define CODEC_SAMPLE_SLICES 4
+// Fraction of repeated bytes above which a block goes straight to RLE
+#define CODEC_RLE_RUN_FRACTION 0.95
+// Sample entropy (bits per byte) above which a block is stored without trying to compress it
+#define CODEC_STORED_ENTROPY 7.9
 
 // Flags for progressive format
 #define FLAG_HAS_CHECKSUM       0x01
 #define FLAG_STREAMING_OPTIMIZED 0x02
 #define FLAG_ENCRYPTED          0x04
 
-// Temporary file for block decompression
-#define TEMP_OUTPUT_FILE "temp_output.dat"
-
 // Progressive compression file header
 typedef struct {
     char magic[4];              // Magic number "PROG"
     uint8_t version;            // Version number
-    uint8_t algorithm;          // Compression algorithm used
+    uint8_t algorithm;          // Compression algorithm used (default codec of version 4+ blocks)
     uint8_t flags;              // Various flags (encrypted, checksum, etc.)
     uint32_t block_size;        // Size of each compressed block
     uint32_t total_blocks;      // Total number of blocks
     uint64_t original_size;     // Original file size
+    uint64_t index_offset;      // Offset of the block index footer (version 2+, 0 if absent)
     ChecksumData checksum;      // File checksum (if used)
 } ProgressiveHeader;
 
@@ -45,26 +65,97 @@ typedef struct {
     uint32_t block_id;          // Block identifier (sequence number)
     uint32_t compressed_size;   // Size of compressed data
     uint32_t original_size;     // Original size before compression 
+    uint8_t codec;              // Algorithm index the block was compressed with, or BLOCK_CODEC_STORED
     ChecksumData block_checksum; // Checksum for this block (if used)
 } BlockHeader;
 
+// Block index footer entry, one per block (version 2+)
+typedef struct {
+    uint64_t offset;            // File offset of the block header
+    uint32_t compressed_size;   // Size of compressed data
+    uint32_t original_size;     // Original size before compression
+} BlockIndexEntry;
+
+// Serialized size of a block index entry
+#define BLOCK_INDEX_ENTRY_SIZE (sizeof(uint64_t) + 2 * sizeof(uint32_t))
+
+// Decoded block held in the block cache
+typedef struct BlockCacheEntry {
+    uint32_t block_id;          // Block held in this entry
+    size_t size;                // Decoded size
+    uint8_t* data;              // Decoded data (block_size bytes allocated)
+    struct BlockCacheEntry* prev; // Next more recently used entry
+    struct BlockCacheEntry* next; // Next less recently used entry
+    struct BlockCacheEntry* hash_next; // Next entry in the same bucket
+} BlockCacheEntry;
+
+// LRU cache of decoded blocks
+typedef struct {
+    BlockCacheEntry* head;      // Most recently used entry
+    BlockCacheEntry* tail;      // Least recently used entry
+    BlockCacheEntry** buckets;  // Lookup table by block ID
+    size_t bucket_mask;         // Bucket count - 1 (power of two)
+    size_t max_entries;         // Entries allowed by the memory budget
+    size_t entry_count;         // Entries currently cached
+    uint64_t hits;              // Lookups served from the cache
+    uint64_t misses;            // Lookups that had to decode
+    uint64_t evictions;         // Entries dropped to stay within budget
+} BlockCache;
+
+// Block cache statistics
+typedef struct {
+    uint64_t hits;              // Lookups served from the cache
+    uint64_t misses;            // Lookups that had to decode
+    uint64_t evictions;         // Entries dropped to stay within budget
+    size_t entries;             // Blocks currently cached
+    size_t bytes_used;          // Memory held by cached blocks
+    size_t capacity;            // Memory budget in bytes
+} BlockCacheStats;
+
+// Access pattern hints for memory-mapped contexts
+typedef enum {
+    PROGRESSIVE_ACCESS_NORMAL = 0,  // No particular pattern
+    PROGRESSIVE_ACCESS_SEQUENTIAL,  // Blocks are read in order (streaming, full decompression)
+    PROGRESSIVE_ACCESS_RANDOM       // Blocks are read in no particular order
+} ProgressiveAccess;
+
+// Per-read scratch buffers, pooled in the context so concurrent readers never share one
+typedef struct ReadScratch {
+    uint8_t* record;            // Block header and compressed data
+    uint8_t* block;             // Decoded block
+    struct ReadScratch* next;   // Next free scratch set
+} ReadScratch;
+
 // Progressive decompression context
+// Block reads, byte-range reads and cache calls may be issued from many threads at once
 typedef struct {
     FILE* file;                 // Input file handle
     char* filename;             // Input filename
+    const uint8_t* map;         // Read-only mapping of the whole file (NULL when not mapped)
+    uint64_t map_size;          // Size of the mapping
     ProgressiveHeader header;   // File header
-    uint64_t current_pos;       // Current file position
-    uint8_t* block_buffer;      // Buffer for reading blocks
-    uint8_t* output_buffer;     // Buffer for decompressed data
-    void* huffman_tree;         // Huffman tree (if Huffman compression used)
+    BlockIndexEntry* block_index; // Block locations (NULL for files without an index), read-only once loaded
+    uint64_t current_pos;       // Current file position (guarded by file_lock)
+    ReadScratch* scratch;       // Free scratch buffers (guarded by cache_lock)
     void* algorithm_context;    // Algorithm-specific context
-    int last_block_id;          // Last block ID processed
+    BlockCache cache;           // Recently decoded blocks (guarded by cache_lock)
+    pthread_mutex_t file_lock;  // Serializes reads that move the stream position
+    pthread_mutex_t cache_lock; // Guards the cache and scratch pool
+    int last_block_id;          // Last block ID read by scanning (guarded by file_lock)
     int initialized;            // Whether initialization completed
 } ProgressiveContext;
 
 // Create a new progressive context
 ProgressiveContext* progressive_init(const char* filename);
 
+// Create a progressive context that decodes blocks straight out of a memory mapping
+// access is passed to progressive_advise. Falls back to stream reads if the file cannot be mapped
+ProgressiveContext* progressive_init_mapped(const char* filename, ProgressiveAccess access);
+
+// Hint the expected access pattern of a mapped context (madvise)
+// Returns 1 if the hint was applied, 0 otherwise
+int progressive_advise(ProgressiveContext* context, ProgressiveAccess access);
+
 // Free a progressive context
 void progressive_free(ProgressiveContext* context);
 
@@ -72,6 +163,23 @@ void progressive_free(ProgressiveContext* context);
 // Returns decompressed data size or -1 on error
 int64_t progressive_decompress_block(ProgressiveContext* context, uint32_t block_id, uint8_t* output, size_t output_size);
 
+// Get the decoded data of a block, setting *data to it
+// Stored blocks of a mapped context point into the mapping with no copy; other blocks are
+// decoded into buffer. Returns the block size or -1 on error
+int64_t progressive_get_block_view(ProgressiveContext* context, uint32_t block_id, uint8_t* buffer,
+                                   size_t buffer_size, const uint8_t** data);
+
+// Read a byte range of the original data, decoding only the blocks it overlaps
+// Returns the number of bytes read (short at end of data) or -1 on error
+int64_t progressive_pread(ProgressiveContext* context, uint64_t offset, size_t length, uint8_t* buffer);
+
+// Set the memory budget of the decoded block cache in bytes (0 disables it)
+// Least recently used blocks are evicted to fit. Returns 1 on success, 0 on failure
+int progressive_set_cache_size(ProgressiveContext* context, size_t max_bytes);
+
+// Get decoded block cache statistics
+void progressive_get_cache_stats(ProgressiveContext* context, BlockCacheStats* stats);
+
 // Get header information without decompressing
 int progressive_get_header(const char* filename, ProgressiveHeader* header);
 
@@ -90,10 +198,19 @@ int progressive_decompress_file(const char* input_file, const char* output_file)
 // Decompress a range of blocks
 int progressive_decompress_range(const char* input_file, const char* output_file, uint32_t start_block, uint32_t end_block);
 
+// Extract a byte range of the original data to a file
+int progressive_extract_bytes(const char* input_file, const char* output_file, uint64_t offset, uint64_t length);
+
 // Stream processing function type (for callback-based processing)
 typedef int (*StreamCallback)(const uint8_t* data, size_t size, void* user_data);
 
 // Process a progressive file through streaming
+// Blocks are decoded ahead on the worker pool while the callback runs
 int progressive_stream_process(const char* input_file, StreamCallback callback, void* user_data);
 
+// Process a progressive file through streaming with up to prefetch_depth blocks decoded ahead
+// of the one being handed to the callback (0 picks a depth from the thread count)
+int progressive_stream_process_prefetch(const char* input_file, StreamCallback callback, void* user_data,
+                                        uint32_t prefetch_depth);
+
 #endif /* PROGRESSIVE_H */ 
\ No newline at end of file
@@ -1,161 +1,367 @@
 /**
  * Run-Length Encoding Implementation
  * Implementation file with compression and decompression functions
+ *
+ * Streams use a PackBits-style layout: a control byte c < 128 is followed by
+ * c + 1 literal bytes, and a control byte c >= 128 is followed by one byte
+ * repeated c - 125 times. Non-repetitive data therefore grows by less than 1%.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include "rle.h"
+#include "large_file_utils.h"
 
-// Max run length (we use 255 since it needs to fit in a byte)
-#define MAX_RUN 255
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Token limits
+#define RLE_MAX_LITERAL 128                  // Literal bytes per control byte
+#define RLE_MIN_RUN 3                        // Shortest run worth a run token
+#define RLE_MAX_RUN (127 + RLE_MIN_RUN)      // Longest run per control byte
+#define RLE_MAX_TOKEN (1 + RLE_MAX_LITERAL)  // Largest encoded token
+
+// Length of the run of p[0] at the start of p, at most max bytes
+static size_t rle_run_length(const uint8_t *p, size_t max) {
+    size_t n = 1;
+
+#if defined(__AVX2__)
+    const __m256i byte32 = _mm256_set1_epi8((char)p[0]);
+    while (n + 32 <= max) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(p + n));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, byte32));
+        if (mask) {
+            return n + __builtin_ctz(mask);
+        }
+        n += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i byte16 = _mm_set1_epi8((char)p[0]);
+    while (n + 16 <= max) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(p + n));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, byte16)) & 0xFFFFu;
+        if (mask) {
+            return n + __builtin_ctz(mask);
+        }
+        n += 16;
+    }
+#endif
+
+    while (n < max && p[n] == p[0]) {
+        n++;
+    }
+    return n;
+}
+
+// Number of bytes to store literally: up to the next run of RLE_MIN_RUN equal bytes,
+// at most max bytes (available is the number of readable bytes at p)
+static size_t rle_literal_length(const uint8_t *p, size_t available, size_t max) {
+    size_t n = 0;
+
+#if defined(__SSE2__)
+    // Compare each position with its two successors, 16 positions at a time
+    while (n + 16 <= max && n + 16 + 2 <= available) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + n));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + n + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + n + 2));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b),
+                                                                  _mm_cmpeq_epi8(a, c)));
+        if (mask) {
+            n += __builtin_ctz(mask);
+            return n > 0 ? n : 1;
+        }
+        n += 16;
+    }
+#endif
+
+    while (n < max && n < available) {
+        if (n + 2 < available && p[n] == p[n + 1] && p[n] == p[n + 2]) {
+            break;
+        }
+        n++;
+    }
+    return n > 0 ? n : 1;
+}
+
+// Worst-case compressed size: one control byte per RLE_MAX_LITERAL literal bytes
+size_t rle_compress_bound(size_t input_size) {
+    return input_size + input_size / RLE_MAX_LITERAL + 1;
+}
+
+// Compress a memory buffer into run and literal tokens
+int compress_rle_buffer(const uint8_t *input, size_t input_size,
+                        uint8_t *output, size_t *output_size) {
+    if (!input || !output || !output_size) {
+        return 1;
+    }
+
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    size_t capacity = *output_size;
+
+    while (in_pos < input_size) {
+        size_t remaining = input_size - in_pos;
+        size_t run = rle_run_length(input + in_pos,
+                                    remaining < RLE_MAX_RUN ? remaining : RLE_MAX_RUN);
+
+        if (run >= RLE_MIN_RUN) {
+            if (out_pos + 2 > capacity) {
+                return 1; // Output buffer too small
+            }
+
+            output[out_pos++] = (uint8_t)(128 + run - RLE_MIN_RUN);
+            output[out_pos++] = input[in_pos];
+            in_pos += run;
+        } else {
+            size_t literal = rle_literal_length(input + in_pos, remaining, RLE_MAX_LITERAL);
+
+            if (out_pos + 1 + literal > capacity) {
+                return 1; // Output buffer too small
+            }
+
+            output[out_pos++] = (uint8_t)(literal - 1);
+            memcpy(output + out_pos, input + in_pos, literal);
+            out_pos += literal;
+            in_pos += literal;
+        }
+    }
+
+    *output_size = out_pos;
+    return 0;
+}
+
+// Decode whole tokens until the input runs out or the next token does not fit
+// Sets *input_used to the bytes consumed and *output_size to the bytes produced
+static int rle_decode_tokens(const uint8_t *input, size_t input_size, size_t *input_used,
+                             uint8_t *output, size_t *output_size) {
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    size_t capacity = *output_size;
+
+    while (in_pos < input_size) {
+        uint8_t control = input[in_pos];
+
+        if (control < 128) {
+            size_t literal = (size_t)control + 1;
+            if (in_pos + 1 + literal > input_size || out_pos + literal > capacity) {
+                break;
+            }
+
+            memcpy(output + out_pos, input + in_pos + 1, literal);
+            out_pos += literal;
+            in_pos += 1 + literal;
+        } else {
+            size_t run = (size_t)control - 128 + RLE_MIN_RUN;
+            if (in_pos + 2 > input_size || out_pos + run > capacity) {
+                break;
+            }
+
+            memset(output + out_pos, input[in_pos + 1], run);
+            out_pos += run;
+            in_pos += 2;
+        }
+    }
+
+    *input_used = in_pos;
+    *output_size = out_pos;
+    return 0;
+}
+
+// Decompress a memory buffer of run and literal tokens
+int decompress_rle_buffer(const uint8_t *input, size_t input_size,
+                          uint8_t *output, size_t *output_size) {
+    if (!input || !output || !output_size) {
+        return 1;
+    }
+
+    size_t input_used;
+    rle_decode_tokens(input, input_size, &input_used, output, output_size);
+
+    // Every token must be decoded; a leftover means truncation or a full output buffer
+    return (input_used == input_size) ? 0 : 1;
+}
 
 // Function to compress a file using RLE
 int compress_rle(const char *input_file, const char *output_file) {
-    FILE *in = fopen(input_file, "rb");
-    if (!in) {
+    LargeFileReader *reader = large_file_reader_init(input_file, DEFAULT_CHUNK_SIZE);
+    if (!reader) {
         printf("Error opening input file: %s\n", input_file);
         return 1;
     }
-    
-    // Get file size
-    fseek(in, 0, SEEK_END);
-    long file_size = ftell(in);
-    fseek(in, 0, SEEK_SET);
-    
+
+    long file_size = (long)reader->file_size;
     printf("DEBUG: RLE compressing file of size %ld bytes\n", file_size);
-    
-    FILE *out = fopen(output_file, "wb");
-    if (!out) {
+
+    LargeFileWriter *writer = large_file_writer_init(output_file, DEFAULT_CHUNK_SIZE);
+    uint8_t *compressed = (uint8_t *)malloc(rle_compress_bound(DEFAULT_CHUNK_SIZE));
+    if (!writer || !compressed) {
         printf("Error opening output file: %s\n", output_file);
-        fclose(in);
+        large_file_writer_free(writer);
+        free(compressed);
+        large_file_reader_free(reader);
         return 1;
     }
-    
+
     // Write original file size
-    if (fwrite(&file_size, sizeof(long), 1, out) != 1) {
+    int result = 0;
+    if (large_file_writer_write(writer, (const uint8_t *)&file_size, sizeof(long)) != 0) {
         printf("Error writing file size to output\n");
-        fclose(in);
-        fclose(out);
-        return 1;
+        result = 1;
     }
-    
-    // Perform RLE compression
-    if (file_size > 0) {
-        int byte = fgetc(in);
-        if (byte == EOF) {
-            printf("Error reading first byte\n");
-            fclose(in);
-            fclose(out);
-            return 1;
-        }
-        
-        uint8_t current_byte = (uint8_t)byte;
-        uint8_t count = 1;
-        
-        for (long i = 1; i < file_size; i++) {
-            byte = fgetc(in);
-            if (byte == EOF) {
-                printf("Error reading byte at position %ld\n", i);
-                fclose(in);
-                fclose(out);
-                return 1;
-            }
-            
-            uint8_t next_byte = (uint8_t)byte;
-            
-            // If same byte and not at max run length
-            if (next_byte == current_byte && count < MAX_RUN) {
-                count++;
-            } else {
-                // Write the run
-                if (fputc(count, out) == EOF || fputc(current_byte, out) == EOF) {
-                    printf("Error writing to output file\n");
-                    fclose(in);
-                    fclose(out);
-                    return 1;
-                }
-                
-                // Start new run
-                current_byte = next_byte;
-                count = 1;
-            }
-        }
-        
-        // Write the last run
-        if (fputc(count, out) == EOF || fputc(current_byte, out) == EOF) {
-            printf("Error writing final run to output file\n");
-            fclose(in);
-            fclose(out);
-            return 1;
+
+    // Compress chunk by chunk; tokens never span chunks, so the output is one stream
+    size_t bytes_read;
+    uint8_t *chunk;
+    while (result == 0 && (chunk = large_file_reader_next_chunk(reader, &bytes_read)) != NULL) {
+        size_t compressed_size = rle_compress_bound(DEFAULT_CHUNK_SIZE);
+
+        if (compress_rle_buffer(chunk, bytes_read, compressed, &compressed_size) != 0 ||
+            large_file_writer_write(writer, compressed, compressed_size) != 0) {
+            printf("Error writing to output file\n");
+            result = 1;
         }
     }
-    
-    printf("DEBUG: RLE compression completed successfully\n");
-    
-    fclose(in);
-    fclose(out);
-    return 0;
+
+    if (result == 0 && large_file_writer_flush(writer) != 0) {
+        printf("Error writing to output file\n");
+        result = 1;
+    }
+
+    if (result == 0) {
+        printf("DEBUG: RLE compression completed successfully\n");
+    }
+
+    free(compressed);
+    large_file_writer_free(writer);
+    large_file_reader_free(reader);
+    return result;
 }
 
 // Function to decompress a file using RLE
 int decompress_rle(const char *input_file, const char *output_file) {
-    FILE *in = fopen(input_file, "rb");
-    if (!in) {
+    LargeFileReader *reader = large_file_reader_init(input_file, DEFAULT_CHUNK_SIZE);
+    if (!reader) {
         printf("Error opening input file: %s\n", input_file);
         return 1;
     }
-    
-    // Read original file size
+
+    // Read original file size from the front of the first chunk
+    size_t bytes_read;
+    uint8_t *chunk = large_file_reader_next_chunk(reader, &bytes_read);
     long file_size;
-    if (fread(&file_size, sizeof(long), 1, in) != 1) {
+    if (!chunk || bytes_read < sizeof(long)) {
         printf("Error reading original file size\n");
-        fclose(in);
+        large_file_reader_free(reader);
         return 1;
     }
-    
+    memcpy(&file_size, chunk, sizeof(long));
+
     printf("DEBUG: RLE decompressing to size %ld bytes\n", file_size);
-    
-    FILE *out = fopen(output_file, "wb");
-    if (!out) {
+
+    LargeFileWriter *writer = large_file_writer_init(output_file, DEFAULT_CHUNK_SIZE);
+    uint8_t *output = (uint8_t *)malloc(DEFAULT_CHUNK_SIZE);
+    if (!writer || !output) {
         printf("Error opening output file: %s\n", output_file);
-        fclose(in);
+        large_file_writer_free(writer);
+        free(output);
+        large_file_reader_free(reader);
         return 1;
     }
-    
-    // Perform RLE decompression
+
+    // A token split across two chunks is completed in this carry buffer
+    uint8_t carry[RLE_MAX_TOKEN];
+    size_t carry_size = 0;
+    size_t chunk_pos = sizeof(long);
+    size_t out_pos = 0;
     long bytes_written = 0;
-    
-    while (bytes_written < file_size) {
-        int count_val = fgetc(in);
-        int byte_val = fgetc(in);
-        
-        if (count_val == EOF || byte_val == EOF) {
-            printf("Error: Unexpected end of file at position %ld\n", bytes_written);
-            fclose(in);
-            fclose(out);
-            return 1;
+    int result = 0;
+
+    while (result == 0 && chunk) {
+        // Finish a token carried over from the previous chunk
+        if (carry_size > 0) {
+            size_t token_size = (carry[0] < 128) ? (size_t)carry[0] + 2 : 2;
+            size_t take = token_size - carry_size;
+            if (take > bytes_read - chunk_pos) {
+                take = bytes_read - chunk_pos;
+            }
+            memcpy(carry + carry_size, chunk + chunk_pos, take);
+            carry_size += take;
+            chunk_pos += take;
         }
-        
-        uint8_t count = (uint8_t)count_val;
-        uint8_t byte = (uint8_t)byte_val;
-        
-        // Write 'count' copies of 'byte'
-        for (int i = 0; i < count && bytes_written < file_size; i++) {
-            if (fputc(byte, out) == EOF) {
+
+        while (result == 0) {
+            // Decode the carried token first, then the rest of the chunk
+            const uint8_t *tokens = carry_size > 0 ? carry : chunk + chunk_pos;
+            size_t token_bytes = carry_size > 0 ? carry_size : bytes_read - chunk_pos;
+            size_t used;
+            size_t produced = DEFAULT_CHUNK_SIZE - out_pos;
+
+            rle_decode_tokens(tokens, token_bytes, &used, output + out_pos, &produced);
+            out_pos += produced;
+
+            if (carry_size > 0) {
+                if (used == carry_size) {
+                    carry_size = 0;
+                    continue;
+                }
+            } else {
+                chunk_pos += used;
+            }
+
+            if (out_pos + RLE_MAX_RUN <= DEFAULT_CHUNK_SIZE) {
+                break; // Input exhausted or token incomplete; output still has room
+            }
+
+            // Output buffer full: write it out
+            if (bytes_written + (long)out_pos > file_size ||
+                large_file_writer_write(writer, output, out_pos) != 0) {
                 printf("Error writing to output file at position %ld\n", bytes_written);
-                fclose(in);
-                fclose(out);
-                return 1;
+                result = 1;
             }
-            bytes_written++;
+            bytes_written += out_pos;
+            out_pos = 0;
         }
+
+        // Keep an incomplete token for the next chunk
+        if (result == 0 && carry_size == 0 && chunk_pos < bytes_read) {
+            carry_size = bytes_read - chunk_pos;
+            memcpy(carry, chunk + chunk_pos, carry_size);
+        }
+
+        chunk = large_file_reader_next_chunk(reader, &bytes_read);
+        chunk_pos = 0;
     }
-    
-    printf("DEBUG: RLE decompression completed successfully\n");
-    
-    fclose(in);
-    fclose(out);
-    return 0;
-} 
\ No newline at end of file
+
+    if (result == 0 && out_pos > 0) {
+        if (bytes_written + (long)out_pos > file_size ||
+            large_file_writer_write(writer, output, out_pos) != 0) {
+            printf("Error writing to output file at position %ld\n", bytes_written);
+            result = 1;
+        }
+        bytes_written += out_pos;
+    }
+
+    if (result == 0 && (carry_size > 0 || bytes_written != file_size)) {
+        printf("Error: Unexpected end of file at position %ld\n", bytes_written);
+        result = 1;
+    }
+
+    if (result == 0 && large_file_writer_flush(writer) != 0) {
+        printf("Error writing to output file\n");
+        result = 1;
+    }
+
+    if (result == 0) {
+        printf("DEBUG: RLE decompression completed successfully\n");
+    }
+
+    free(output);
+    large_file_writer_free(writer);
+    large_file_reader_free(reader);
+    return result;
+}
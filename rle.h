@@ -5,10 +5,21 @@
 #ifndef RLE_H
 #define RLE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Function to compress a file using RLE
 int compress_rle(const char *input_file, const char *output_file);
 
 // Function to decompress a file using RLE
 int decompress_rle(const char *input_file, const char *output_file);
 
+// Buffer operations
+// *output_size holds the capacity of output on entry and the bytes produced on return
+size_t rle_compress_bound(size_t input_size);
+int compress_rle_buffer(const uint8_t *input, size_t input_size,
+                        uint8_t *output, size_t *output_size);
+int decompress_rle_buffer(const uint8_t *input, size_t input_size,
+                          uint8_t *output, size_t *output_size);
+
 #endif // RLE_H 
\ No newline at end of file
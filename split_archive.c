@@ -24,6 +24,12 @@ typedef struct {
     uint8_t checksum_data[32];  // Checksum data (size depends on checksum type)
 } ArchivePartHeader;
 
+// Each compressed chunk in a part is preceded by a frame giving its sizes
+typedef struct {
+    uint32_t original_size;   // Uncompressed size of the chunk
+    uint32_t compressed_size; // Size of the compressed payload that follows
+} ChunkFrame;
+
 // Get filename for a specific part
 static char* get_part_filename(const char* base_filename, uint32_t part_number) {
     // Calculate required buffer size: base + ".part" + part number (max 4 digits) + NULL
@@ -64,21 +70,19 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
         max_part_size = MIN_SPLIT_SIZE;
     }
     
-    // Open input file
-    FILE* input = fopen(input_file, "rb");
+    // Open input file; chunks are compressed straight out of a mapped window
+    size_t buffer_size = DEFAULT_CHUNK_SIZE;
+    LargeFileReader* input = large_file_reader_init_mapped(input_file, buffer_size);
     if (!input) {
         fprintf(stderr, "Error: Could not open input file %s\n", input_file);
         return -1;
     }
     
-    // Get file size
-    fseek(input, 0, SEEK_END);
-    int64_t file_size = ftell(input);
-    fseek(input, 0, SEEK_SET);
+    uint64_t file_size = input->file_size;
     
-    if (file_size <= 0) {
+    if (file_size == 0) {
         fprintf(stderr, "Error: Invalid file size for %s\n", input_file);
-        fclose(input);
+        large_file_reader_free(input);
         return -1;
     }
     
@@ -88,7 +92,7 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
     if (total_parts > MAX_SPLIT_FILES) {
         fprintf(stderr, "Error: Required %u parts exceeds maximum of %u\n", 
                 total_parts, MAX_SPLIT_FILES);
-        fclose(input);
+        large_file_reader_free(input);
         return -1;
     }
     
@@ -96,15 +100,19 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
            total_parts, (unsigned long long)max_part_size);
     
     // Allocate buffer for compressed data
-    size_t buffer_size = DEFAULT_CHUNK_SIZE;
-    uint8_t* input_buffer = (uint8_t*)malloc(buffer_size);
-    uint8_t* compressed_buffer = (uint8_t*)malloc(buffer_size * 2); // Worst case expansion
+    size_t compressed_capacity = compress_bound(algorithm_index, buffer_size);
+    if (compressed_capacity == 0) {
+        fprintf(stderr, "Error: Algorithm %d does not support split archives\n", algorithm_index);
+        large_file_reader_free(input);
+        return -1;
+    }
+    
+    uint8_t* compressed_buffer = (uint8_t*)malloc(compressed_capacity);
     
-    if (!input_buffer || !compressed_buffer) {
+    if (!compressed_buffer) {
         fprintf(stderr, "Error: Memory allocation failed for buffers\n");
-        free(input_buffer);
         free(compressed_buffer);
-        fclose(input);
+        large_file_reader_free(input);
         return -1;
     }
     
@@ -117,9 +125,8 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
         // Open output file for this part
         char* part_filename = get_part_filename(output_base, current_part);
         if (!part_filename) {
-            free(input_buffer);
             free(compressed_buffer);
-            fclose(input);
+            large_file_reader_free(input);
             return -1;
         }
         
@@ -127,9 +134,8 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
         if (!output) {
             fprintf(stderr, "Error: Could not open output file %s\n", part_filename);
             free(part_filename);
-            free(input_buffer);
             free(compressed_buffer);
-            fclose(input);
+            large_file_reader_free(input);
             return -1;
         }
         
@@ -153,9 +159,8 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
         if (fwrite(&header, sizeof(header), 1, output) != 1) {
             fprintf(stderr, "Error: Failed to write header for part %u\n", current_part);
             fclose(output);
-            free(input_buffer);
             free(compressed_buffer);
-            fclose(input);
+            large_file_reader_free(input);
             return -1;
         }
         
@@ -167,37 +172,39 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
             size_t read_size = (part_remaining > buffer_size) ? 
                              buffer_size : (size_t)part_remaining;
             
-            size_t bytes_read = fread(input_buffer, 1, read_size, input);
-            if (bytes_read != read_size) {
+            size_t bytes_read;
+            const uint8_t* input_buffer = large_file_reader_next_chunk_max(input, read_size, &bytes_read);
+            if (!input_buffer || bytes_read != read_size) {
                 fprintf(stderr, "Error: Failed to read from input file\n");
                 fclose(output);
-                free(input_buffer);
                 free(compressed_buffer);
-                fclose(input);
+                large_file_reader_free(input);
                 return -1;
             }
             
             // Compress the chunk using the specified algorithm
-            size_t output_size = buffer_size * 2;
-            int compressed_size = compress_buffer(algorithm_index, input_buffer, bytes_read,
-                                                 compressed_buffer, &output_size);
-            
-            if (compressed_size < 0) {
+            size_t output_size = compressed_capacity;
+            if (!compress_buffer(algorithm_index, input_buffer, bytes_read,
+                                 compressed_buffer, &output_size)) {
                 fprintf(stderr, "Error: Compression failed\n");
                 fclose(output);
-                free(input_buffer);
                 free(compressed_buffer);
-                fclose(input);
+                large_file_reader_free(input);
                 return -1;
             }
             
-            // Write compressed data to output
-            if (fwrite(compressed_buffer, 1, output_size, output) != output_size) {
+            // Write the chunk frame followed by the compressed data
+            ChunkFrame frame;
+            frame.original_size = (uint32_t)bytes_read;
+            frame.compressed_size = (uint32_t)output_size;
+            
+            if (fwrite(&frame.original_size, sizeof(uint32_t), 1, output) != 1 ||
+                fwrite(&frame.compressed_size, sizeof(uint32_t), 1, output) != 1 ||
+                fwrite(compressed_buffer, 1, output_size, output) != output_size) {
                 fprintf(stderr, "Error: Failed to write to output file\n");
                 fclose(output);
-                free(input_buffer);
                 free(compressed_buffer);
-                fclose(input);
+                large_file_reader_free(input);
                 return -1;
             }
             
@@ -218,9 +225,8 @@ int compress_to_split_archive(const char* input_file, const char* output_base,
     }
     
     // Clean up
-    free(input_buffer);
     free(compressed_buffer);
-    fclose(input);
+    large_file_reader_free(input);
     
     printf("Split archive creation completed: %u parts created\n", total_parts);
     return 0;
@@ -290,7 +296,14 @@ int decompress_from_split_archive(const char* input_base, const char* output_fil
     
     // Allocate buffers
     size_t buffer_size = DEFAULT_CHUNK_SIZE;
-    uint8_t* compressed_buffer = (uint8_t*)malloc(buffer_size);
+    size_t compressed_capacity = compress_bound(algorithm_index, buffer_size);
+    if (compressed_capacity == 0) {
+        fprintf(stderr, "Error: Algorithm %d does not support split archives\n", algorithm_index);
+        fclose(output);
+        return -1;
+    }
+    
+    uint8_t* compressed_buffer = (uint8_t*)malloc(compressed_capacity);
     uint8_t* decompressed_buffer = (uint8_t*)malloc(buffer_size);
     
     if (!compressed_buffer || !decompressed_buffer) {
@@ -329,18 +342,35 @@ int decompress_from_split_archive(const char* input_base, const char* output_fil
         // Skip header
         fseek(part_file, sizeof(ArchivePartHeader), SEEK_SET);
         
-        // Process the part in chunks
-        while (!feof(part_file)) {
-            // Read a chunk of compressed data
-            size_t bytes_read = fread(compressed_buffer, 1, buffer_size, part_file);
-            if (bytes_read == 0) break;
+        // Process the part one framed chunk at a time
+        ChunkFrame frame;
+        while (fread(&frame.original_size, sizeof(uint32_t), 1, part_file) == 1) {
+            if (fread(&frame.compressed_size, sizeof(uint32_t), 1, part_file) != 1 ||
+                frame.original_size > buffer_size || frame.compressed_size > compressed_capacity) {
+                fprintf(stderr, "Error: Corrupt chunk frame in part %u\n", part);
+                fclose(part_file);
+                free(compressed_buffer);
+                free(decompressed_buffer);
+                fclose(output);
+                return -1;
+            }
             
-            // Decompress the chunk
-            size_t output_size = buffer_size;
-            int decompressed_size = decompress_buffer(algorithm_index, compressed_buffer, bytes_read,
-                                                     decompressed_buffer, &output_size);
+            // Read the compressed chunk
+            size_t bytes_read = fread(compressed_buffer, 1, frame.compressed_size, part_file);
+            if (bytes_read != frame.compressed_size) {
+                fprintf(stderr, "Error: Truncated chunk in part %u\n", part);
+                fclose(part_file);
+                free(compressed_buffer);
+                free(decompressed_buffer);
+                fclose(output);
+                return -1;
+            }
             
-            if (decompressed_size < 0) {
+            // Decompress the chunk
+            size_t output_size = frame.original_size;
+            if (!decompress_buffer(algorithm_index, compressed_buffer, bytes_read,
+                                   decompressed_buffer, &output_size) ||
+                output_size != frame.original_size) {
                 fprintf(stderr, "Error: Decompression failed\n");
                 fclose(part_file);
                 free(compressed_buffer);
@@ -360,7 +390,7 @@ int decompress_from_split_archive(const char* input_base, const char* output_fil
             }
             
             // Update progress
-            total_processed += decompressed_size;
+            total_processed += output_size;
         }
         
         fclose(part_file);
@@ -0,0 +1,158 @@
+/**
+ * XXH64 Hash Implementation
+ *
+ * Follows the xxHash specification: the input is consumed in 32-byte stripes
+ * by four independent 64-bit lanes, which keeps several multiplies in flight
+ * per cycle, then the lanes are merged, the tail mixed in and the result
+ * avalanched. Output matches the reference XXH64.
+ */
+#include <string.h>
+#include "xxh64.h"
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+// Stripe size consumed by the four lanes
+#define XXH_STRIPE_SIZE 32
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Load 8 bytes as a little-endian word
+static inline uint64_t xxh_read64(const uint8_t* p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+// Load 4 bytes as a little-endian word
+static inline uint32_t xxh_read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Mix one 8-byte input into a lane
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+// Fold a lane into the merged hash
+static inline uint64_t xxh_merge_round(uint64_t hash, uint64_t acc) {
+    hash ^= xxh_round(0, acc);
+    return hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// Consume whole stripes, returning the bytes used
+static size_t xxh_consume_stripes(uint64_t acc[4], const uint8_t* data, size_t size) {
+    const uint8_t* p = data;
+    uint64_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+
+    while (size >= XXH_STRIPE_SIZE) {
+        a0 = xxh_round(a0, xxh_read64(p));
+        a1 = xxh_round(a1, xxh_read64(p + 8));
+        a2 = xxh_round(a2, xxh_read64(p + 16));
+        a3 = xxh_round(a3, xxh_read64(p + 24));
+        p += XXH_STRIPE_SIZE;
+        size -= XXH_STRIPE_SIZE;
+    }
+
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+    return (size_t)(p - data);
+}
+
+// Start a streaming hash
+void xxh64_init(Xxh64State* state, uint64_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->seed = seed;
+    state->acc[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    state->acc[1] = seed + XXH_PRIME64_2;
+    state->acc[2] = seed;
+    state->acc[3] = seed - XXH_PRIME64_1;
+}
+
+// Add data to a streaming hash
+void xxh64_update(Xxh64State* state, const uint8_t* data, size_t size) {
+    if (!data || size == 0) {
+        return;
+    }
+    state->total_len += size;
+
+    // Complete a partially filled stripe first
+    if (state->buffer_size > 0) {
+        size_t fill = XXH_STRIPE_SIZE - state->buffer_size;
+        if (size < fill) {
+            memcpy(state->buffer + state->buffer_size, data, size);
+            state->buffer_size += (uint32_t)size;
+            return;
+        }
+        memcpy(state->buffer + state->buffer_size, data, fill);
+        xxh_consume_stripes(state->acc, state->buffer, XXH_STRIPE_SIZE);
+        data += fill;
+        size -= fill;
+        state->buffer_size = 0;
+    }
+
+    size_t used = xxh_consume_stripes(state->acc, data, size);
+    memcpy(state->buffer, data + used, size - used);
+    state->buffer_size = (uint32_t)(size - used);
+}
+
+// Hash of everything added so far
+uint64_t xxh64_digest(const Xxh64State* state) {
+    uint64_t hash;
+
+    if (state->total_len >= XXH_STRIPE_SIZE) {
+        const uint64_t* acc = state->acc;
+        hash = xxh_rotl64(acc[0], 1) + xxh_rotl64(acc[1], 7) + xxh_rotl64(acc[2], 12) + xxh_rotl64(acc[3], 18);
+        hash = xxh_merge_round(hash, acc[0]);
+        hash = xxh_merge_round(hash, acc[1]);
+        hash = xxh_merge_round(hash, acc[2]);
+        hash = xxh_merge_round(hash, acc[3]);
+    } else {
+        hash = state->seed + XXH_PRIME64_5;
+    }
+    hash += state->total_len;
+
+    // Mix in the tail
+    const uint8_t* p = state->buffer;
+    size_t remaining = state->buffer_size;
+    while (remaining >= 8) {
+        hash ^= xxh_round(0, xxh_read64(p));
+        hash = xxh_rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        hash ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        hash = xxh_rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining--) {
+        hash ^= (*p++) * XXH_PRIME64_5;
+        hash = xxh_rotl64(hash, 11) * XXH_PRIME64_1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// XXH64 of a buffer
+uint64_t xxh64(const uint8_t* data, size_t size, uint64_t seed) {
+    Xxh64State state;
+    xxh64_init(&state, seed);
+    xxh64_update(&state, data, size);
+    return xxh64_digest(&state);
+}
@@ -0,0 +1,32 @@
+/**
+ * XXH64 Hashing
+ * Fast non-cryptographic 64-bit hash (xxHash, XXH64 variant), usable one-shot or streamed
+ */
+#ifndef XXH64_H
+#define XXH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming XXH64 state
+typedef struct {
+    uint64_t total_len;         // Bytes hashed so far
+    uint64_t seed;              // Seed the state was started with
+    uint64_t acc[4];            // Lane accumulators
+    uint8_t buffer[32];         // Input not yet consumed as a full stripe
+    uint32_t buffer_size;       // Bytes held in buffer
+} Xxh64State;
+
+// Start a streaming hash
+void xxh64_init(Xxh64State* state, uint64_t seed);
+
+// Add data to a streaming hash
+void xxh64_update(Xxh64State* state, const uint8_t* data, size_t size);
+
+// Hash of everything added so far (the state may keep being updated)
+uint64_t xxh64_digest(const Xxh64State* state);
+
+// XXH64 of a buffer
+uint64_t xxh64(const uint8_t* data, size_t size, uint64_t seed);
+
+#endif /* XXH64_H */